@@ -0,0 +1,395 @@
+# include "cli.hpp"
+# include "graph.hpp"
+# include <chrono>
+# include <random>
+# include <dirent.h>
+
+// Directory the flow logs of the benchmark are written to
+# define BENCH_LOG_DIR "bench_logs"
+# define BENCH_RUNS 3      // Runs of start_flow timed
+
+// Edges of a synthetic topology and the flow simulated on it
+struct Topology
+{
+    std::string name;
+    size_t nodes;
+    std::vector<EdgeEntry> edges;
+    NodeID src;
+    NodeID dest;
+};
+
+// Timings of a topology
+struct BenchResult
+{
+    double build_sec;           // Graph build (add_edge)
+    double freeze_sec;          // Graph::freeze of the built graph
+    size_t paths;               // Paths listed by get_paths
+    double paths_sec;
+    double setup_sec;           // Flow setup (start_flow of 0 cycles)
+    double cycles_per_sec_log;  // start_flow, every cycle logged
+    double cycles_per_sec_nolog;// start_flow, last cycle logged
+    double parse_lines_per_sec; // Cli::parse_cmds of the add_edge lines
+};
+
+static std::mt19937 gRandom;
+
+EdgeWeight random_weight()
+{
+    return 1 + gRandom() % 20;
+}
+
+void add(Topology& topology, NodeID src, NodeID dest, EdgeWeight weight)
+{
+    EdgeEntry entry = {src, dest, weight};
+    topology.edges.push_back(entry);
+}
+
+// 1 -> 2 -> ... -> n
+Topology chain(size_t n)
+{
+    Topology topology;
+    topology.name = "chain";
+    topology.nodes = n;
+    for (size_t i = 1; i < n; ++i) {
+        add(topology, i, i + 1, random_weight());
+    }
+    topology.src = 1;
+    topology.dest = n;
+    return topology;
+}
+
+// Edges to the right and down, corner to corner
+Topology grid(size_t width, size_t height)
+{
+    Topology topology;
+    topology.name = "grid";
+    topology.nodes = width * height;
+    for (size_t r = 0; r < height; ++r) {
+        for (size_t c = 0; c < width; ++c) {
+            NodeID id = r * width + c + 1;
+            if (c + 1 < width) {
+                add(topology, id, id + 1, random_weight());
+            }
+            if (r + 1 < height) {
+                add(topology, id, id + width, random_weight());
+            }
+        }
+    }
+    topology.src = 1;
+    topology.dest = width * height;
+    return topology;
+}
+
+// Chain of n nodes and random edges from lower to higher node, m in all
+Topology random_dag(size_t n, size_t m)
+{
+    Topology topology = chain(n);
+    topology.name = "random_dag";
+    std::set<std::pair<NodeID, NodeID> > added;
+    for (size_t i = 1; i < n; ++i) {
+        added.insert(std::make_pair(i, i + 1));
+    }
+    while (topology.edges.size() < m) {
+        NodeID a = 1 + gRandom() % n;
+        NodeID b = 1 + gRandom() % n;
+        if (a == b) {
+            continue;
+        }
+        std::pair<NodeID, NodeID> edge(std::min(a, b), std::max(a, b));
+        if (added.insert(edge).second) {
+            add(topology, edge.first, edge.second, random_weight());
+        }
+    }
+    return topology;
+}
+
+// k-ary fat-tree (k even) with links both ways: (k/2)^2 core switches,
+// k pods of k/2 aggregation and k/2 edge switches, k/2 hosts per edge
+// switch. The flow is b/w first and last host
+Topology fat_tree(size_t k)
+{
+    Topology topology;
+    topology.name = "fat_tree";
+    size_t half = k / 2;
+    size_t cores = half * half;
+    NodeID agg = cores + 1;                 // First aggregation switch
+    NodeID edge = agg + k * half;           // First edge switch
+    NodeID host = edge + k * half;          // First host
+    topology.nodes = host - 1 + k * half * half;
+    for (size_t p = 0; p < k; ++p) {
+        for (size_t a = 0; a < half; ++a) {
+            NodeID id = agg + p * half + a;
+            for (size_t c = 0; c < half; ++c) {
+                add(topology, id, 1 + a * half + c, 10);
+                add(topology, 1 + a * half + c, id, 10);
+            }
+            for (size_t e = 0; e < half; ++e) {
+                add(topology, id, edge + p * half + e, 10);
+                add(topology, edge + p * half + e, id, 10);
+            }
+        }
+        for (size_t e = 0; e < half; ++e) {
+            NodeID id = edge + p * half + e;
+            for (size_t h = 0; h < half; ++h) {
+                NodeID leaf = host + (p * half + e) * half + h;
+                add(topology, id, leaf, 10);
+                add(topology, leaf, id, 10);
+            }
+        }
+    }
+    topology.src = host;
+    topology.dest = topology.nodes;
+    return topology;
+}
+
+// Preferential attachment: each new node has edges to m older nodes
+// picked by their degree. The flow is from the last node to the first
+Topology power_law(size_t n, size_t m)
+{
+    Topology topology;
+    topology.name = "power_law";
+    topology.nodes = n;
+    std::vector<NodeID> ends;       // Node once for each edge end
+    for (NodeID i = 1; i <= m + 1; ++i) {
+        for (NodeID j = 1; j < i; ++j) {
+            add(topology, i, j, random_weight());
+            ends.push_back(i);
+            ends.push_back(j);
+        }
+    }
+    for (NodeID i = m + 2; i <= n; ++i) {
+        std::set<NodeID> targets;
+        while (targets.size() < m) {
+            targets.insert(ends[gRandom() % ends.size()]);
+        }
+        for (std::set<NodeID>::iterator it = targets.begin();
+                it != targets.end(); ++it) {
+            add(topology, i, *it, random_weight());
+            ends.push_back(i);
+            ends.push_back(*it);
+        }
+    }
+    topology.src = n;
+    topology.dest = 1;
+    return topology;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+// Remove the flow logs written so far
+void remove_logs()
+{
+    DIR* dir = opendir(".");
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        std::string name(entry->d_name);
+        if (name.compare(0, 5, "flow_") == 0 || name.compare(0, 6, "flows_") == 0) {
+            std::remove(name.c_str());
+        }
+    }
+    closedir(dir);
+}
+
+// Best time of start_flow out of BENCH_RUNS runs
+double flow_sec(Simulation& simulation, Topology& topology, size_t cycles,
+        size_t every)
+{
+    FlowOptions options;
+    options.every = every;
+    // Every cycle is to be simulated
+    options.steady = false;
+    double best = 0;
+    for (size_t r = 0; r < BENCH_RUNS; ++r) {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        simulation.start(topology.src, topology.dest, cycles, options);
+        double sec = seconds_since(start);
+        remove_logs();
+        if ((r == 0) || (sec < best)) {
+            best = sec;
+        }
+    }
+    return best;
+}
+
+// Cycles per second of start_flow. Setup time of the flow is excluded,
+// unless the cycles take less than its noise
+double cycles_per_sec(double sec, double setup_sec, size_t cycles)
+{
+    if (sec > setup_sec) {
+        sec -= setup_sec;
+    }
+    return (sec > 0) ? cycles / sec : 0;
+}
+
+BenchResult run(Topology& topology, size_t cycles, size_t max_paths)
+{
+    BenchResult result;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    Graph graph(topology.nodes, topology.edges.size());
+    for (size_t k = 0; k < topology.edges.size(); ++k) {
+        EdgeEntry& entry = topology.edges[k];
+        graph.add_edge(entry.src, entry.dest, entry.weight);
+    }
+    result.build_sec = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    graph.freeze();
+    result.freeze_sec = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    result.paths = graph.get_paths(topology.src, topology.dest,
+            max_paths).size();
+    result.paths_sec = seconds_since(start);
+
+    Simulation simulation(&graph);
+    result.setup_sec = flow_sec(simulation, topology, 0, 0);
+    result.cycles_per_sec_log = cycles_per_sec(
+            flow_sec(simulation, topology, cycles, 0),
+            result.setup_sec, cycles);
+    result.cycles_per_sec_nolog = cycles_per_sec(
+            flow_sec(simulation, topology, cycles, cycles),
+            result.setup_sec, cycles);
+
+    // Commands to build the graph
+    std::vector<std::string> lines;
+    for (size_t k = 0; k < topology.edges.size(); ++k) {
+        EdgeEntry& entry = topology.edges[k];
+        lines.push_back("add_edge -src_node " + Log::itos(entry.src) +
+                " -dest_node " + Log::itos(entry.dest) +
+                " -weight " + Log::itos(entry.weight));
+    }
+    Cli* cli = Cli::Instance();
+    start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < lines.size(); ++k) {
+        cli->parse_cmds(lines[k]);
+        cli->reset_values();
+    }
+    double sec = seconds_since(start);
+    result.parse_lines_per_sec = (sec > 0) ? lines.size() / sec : 0;
+    return result;
+}
+
+void write_json(std::ostream& out, std::vector<Topology>& topologies,
+        std::vector<BenchResult>& results, size_t scale, size_t cycles)
+{
+    out << "{\n";
+    out << "  \"scale\": " << scale << ",\n";
+    out << "  \"cycles\": " << cycles << ",\n";
+    out << "  \"topologies\": [\n";
+    for (size_t t = 0; t < topologies.size(); ++t) {
+        Topology& topology = topologies[t];
+        BenchResult& result = results[t];
+        out << "    {\n";
+        out << "      \"name\": \"" << topology.name << "\",\n";
+        out << "      \"nodes\": " << topology.nodes << ",\n";
+        out << "      \"edges\": " << topology.edges.size() << ",\n";
+        out << "      \"src\": " << topology.src << ",\n";
+        out << "      \"dest\": " << topology.dest << ",\n";
+        out << "      \"build_sec\": " << result.build_sec << ",\n";
+        out << "      \"freeze_sec\": " << result.freeze_sec << ",\n";
+        out << "      \"paths\": " << result.paths << ",\n";
+        out << "      \"paths_sec\": " << result.paths_sec << ",\n";
+        out << "      \"setup_sec\": " << result.setup_sec << ",\n";
+        out << "      \"cycles_per_sec_log\": " << result.cycles_per_sec_log << ",\n";
+        out << "      \"cycles_per_sec_nolog\": " << result.cycles_per_sec_nolog << ",\n";
+        out << "      \"parse_lines_per_sec\": " << result.parse_lines_per_sec << "\n";
+        out << "    }" << ((t + 1 < topologies.size()) ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+void print_usage(char* name)
+{
+    std::cout << "\n\n  Usage : " << name << " [OPTIONS]\n\n";
+    std::cout << "  -out <FILE_NAME>                 JSON results file (default: stdout only)\n\n";
+    std::cout << "  -scale <SCALE>                   Size of the topologies (default: 1)\n\n";
+    std::cout << "  -cycles <CYCLES>                 Cycles of start_flow (default: 100)\n\n";
+    std::cout << "  -topology <NAME>                 chain, grid, random_dag, fat_tree or power_law\n";
+    std::cout << "                                   (default: all)\n\n";
+    std::cout << "  -max_paths <MAX_PATHS>           Paths listed by get_paths (default: 1000)\n\n";
+    std::cout << "  -seed <SEED>                     Seed of the random topologies (default: 1)\n\n";
+    exit(-1);
+}
+
+int main(int argc, char** argv)
+{
+    Cli *cli = Cli::Instance();
+    update_available_option(cli);
+    char** end = argv + argc;
+    if (cli->cmd_exists(argv, end, "-help")) {
+        print_usage(argv[0]);
+    }
+
+    size_t scale = 1;
+    size_t cycles = 100;
+    size_t max_paths = 1000;
+    const char* value;
+    if ((value = cli->get_cmd_value(argv, end, "-scale"))) {
+        scale = std::max(atoi(value), 1);
+    }
+    if ((value = cli->get_cmd_value(argv, end, "-cycles"))) {
+        cycles = atoi(value);
+    }
+    if ((value = cli->get_cmd_value(argv, end, "-max_paths"))) {
+        max_paths = atoi(value);
+    }
+    if ((value = cli->get_cmd_value(argv, end, "-seed"))) {
+        gRandom.seed(atoi(value));
+    }
+    const char* only = cli->get_cmd_value(argv, end, "-topology");
+
+    // About 2000 nodes each at scale 1
+    std::vector<Topology> topologies;
+    topologies.push_back(chain(2000 * scale));
+    topologies.push_back(grid(50 * scale, 40));
+    topologies.push_back(random_dag(2000 * scale, 8000 * scale));
+    topologies.push_back(fat_tree(2 * (scale + 3)));
+    topologies.push_back(power_law(2000 * scale, 3));
+    if (only) {
+        std::vector<Topology> selected;
+        for (size_t t = 0; t < topologies.size(); ++t) {
+            if (topologies[t].name == only) {
+                selected.push_back(topologies[t]);
+            }
+        }
+        if (selected.empty()) {
+            print_usage(argv[0]);
+        }
+        topologies.swap(selected);
+    }
+
+    // The flow logs are written in a directory of their own
+    mkdir(BENCH_LOG_DIR, 0755);
+    if (chdir(BENCH_LOG_DIR) != 0) {
+        std::cout << "\nError: Failed to create directory " << BENCH_LOG_DIR << "\n";
+        return -1;
+    }
+    std::vector<BenchResult> results;
+    for (size_t t = 0; t < topologies.size(); ++t) {
+        results.push_back(run(topologies[t], cycles, max_paths));
+    }
+    if (chdir("..") == 0) {
+        rmdir(BENCH_LOG_DIR);
+    }
+
+    write_json(std::cout, topologies, results, scale, cycles);
+    if ((value = cli->get_cmd_value(argv, end, "-out"))) {
+        std::ofstream out(value);
+        if (out.fail()) {
+            std::cout << "\nError: Failed to create file " << value << "\n";
+            return -1;
+        }
+        write_json(out, topologies, results, scale, cycles);
+    }
+    return 0;
+}
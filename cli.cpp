@@ -43,10 +43,18 @@ std::string& Flag::get_usage()
 std::string& Option::get_usage()
 {
     if (_mUsage.empty()) {
+        if (__mOptional) {
+            _mUsage.append("[");
+        }
         _mUsage.append(_mName);
-        _mUsage.append(" <");
-        _mUsage.append(__mShortDesc);
-        _mUsage.append(">");
+        if (__mShortDesc.size()) {
+            _mUsage.append(" <");
+            _mUsage.append(__mShortDesc);
+            _mUsage.append(">");
+        }
+        if (__mOptional) {
+            _mUsage.append("]");
+        }
 
         if (_mDesc.size()){
             _mUsage.append(align());
@@ -61,6 +69,11 @@ bool Option::is_required()
     return __mRequiredValue;
 }
 
+bool Option::is_optional()
+{
+    return __mOptional;
+}
+
 /**********************************************************************
  *                     Title class methods                           *
  **********************************************************************/
@@ -86,16 +99,21 @@ size_t Title::get_sub_option_count()
 }
 
 void Title::add_sub_option(const std::string& name, const std::string& desc,
-        const std::string& short_desc, bool required)
+        const std::string& short_desc, bool required, bool optional)
 {
     // Make the describtion as empty to denote it is sub option
     desc.empty();
 
     // Create and insert the sub option
-    Option *sub_option = new Option(name, desc, short_desc, required);
+    Option *sub_option = new Option(name, desc, short_desc, required, optional);
     __mSubOptions.push_back(sub_option);
 }
 
+const std::vector<Option*>& Title::get_sub_options()
+{
+    return __mSubOptions;
+}
+
 /**********************************************************************
  *                     Cli class methods                           *
  **********************************************************************/
@@ -116,6 +134,7 @@ void Cli::add_flag(const std::string& name, const std::string& desc)
     Cmd *cmd = new Flag(name, desc);
     __mFlagList.push_back(cmd);
     __mCmdNames.insert(std::pair<std::string, bool>(name, false));
+    __mIndexed = false;
 }
 
 void Cli::add_option(const std::string& name, const std::string& desc,
@@ -124,6 +143,7 @@ void Cli::add_option(const std::string& name, const std::string& desc,
     Cmd *cmd = new Option(name, desc, short_desc, required);
     __mOptionList.push_back(cmd);
     __mCmdNames.insert(std::pair<std::string, bool>(name, required));
+    __mIndexed = false;
 }
 
 Title* Cli::add_title(const std::string& name, const std::string& desc)
@@ -132,21 +152,23 @@ Title* Cli::add_title(const std::string& name, const std::string& desc)
     Cmd *cmd = new Title(name, desc);
     __mTitleList.push_back(cmd);
     __mCmdNames.insert(std::pair<std::string, bool>(name, false));
+    __mIndexed = false;
     return (dynamic_cast<Title*>(cmd));
 }
 
 void Cli::add_title_sub_option(Title* tptr, const std::string& name,
         const std::string& desc,
-        const std::string& short_desc, bool required)
+        const std::string& short_desc, bool required, bool optional)
 {
     // Insert in a title and sub option map
     std::string new_name (tptr->get_name());
     new_name.append(" ");
     new_name.append(name);
     __mCmdNames.insert(std::pair<std::string, bool>(new_name, required));
+    __mIndexed = false;
 
     // Call function to add sub option in title class.
-    tptr->add_sub_option(name, desc, short_desc, required);
+    tptr->add_sub_option(name, desc, short_desc, required, optional);
 }
 
 // Char** version
@@ -211,100 +233,301 @@ std::string& Cli::usage()
 
 // Validates whether all sub options are given
 // if corresponding title command is given
-bool Cli::validate_title_sub_options()
-{
-    // Iterate through all title command list
-    for(int i = 0 ; i < __mTitleList.size(); ++i) {
-        std::string name = __mTitleList[i]->get_name();
-        if(__mValues.count(name)) {
-            size_t count = (dynamic_cast<Title*>(__mTitleList[i]))->get_sub_option_count();
-            if  (__mValues.size() != (count +1)){
-                std::cout << "\nError: Suboption is not given properly for " <<  name << "\n";
-                return false;
+bool Cli::validate_title_sub_options(ParsedCmd& cmd)
+{
+    // Iterate through the titles given
+    for (size_t i = 0; i < cmd.given.size(); ++i) {
+        CmdEntry& entry = __mEntries[cmd.given[i]];
+        if (entry.title == NULL) {
+            continue;
+        }
+        // Title itself and the given sub options only
+        size_t given = 1;
+        bool valid = true;
+        for (size_t k = 0; k < entry.subs.size(); ++k) {
+            if (cmd.values[entry.subs[k]]) {
+                ++given;
+            }
+            else if (!entry.optional[k]) {
+                valid = false;
             }
         }
+        if (!valid || (given != cmd.given.size())) {
+            cmd.error = "\nError: Suboption is not given properly for ";
+            cmd.error.append(entry.name).append("\n");
+            return false;
+        }
     }
     return true;
 }
 
-// Get value of given option
-const char* Cli::get_value(const std::string& option)
+// FNV-1a hash of the name with the seed
+size_t Cli::__hash(std::string_view name, size_t seed)
 {
-    std::map<std::string, std::string>::iterator it = __mValues.find(option);
+    size_t hash = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (size_t i = 0; i < name.size(); ++i) {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+// Build the entries from the commands added, and find a seed that
+// hashes each entry to a slot of its own
+void Cli::__build_index()
+{
+    __mEntries.clear();
+    std::map<std::string, size_t> names;
+    std::map<std::string, bool>::iterator nIter = __mCmdNames.begin();
+    for (; nIter != __mCmdNames.end(); ++nIter) {
+        // Sub options are added as "title sub_option"
+        std::string name(nIter->first.substr(nIter->first.find(' ') + 1));
+        std::map<std::string, size_t>::iterator it = names.find(name);
+        if (it == names.end()) {
+            names[name] = __mEntries.size();
+            __mEntries.push_back(CmdEntry(name, nIter->second));
+        }
+        else {
+            __mEntries[it->second].required |= nIter->second;
+        }
+    }
+    for (size_t i = 0; i < __mTitleList.size(); ++i) {
+        Title* title = dynamic_cast<Title*>(__mTitleList[i]);
+        CmdEntry& entry = __mEntries[names[title->get_name()]];
+        entry.title = title;
+        const std::vector<Option*>& subs = title->get_sub_options();
+        for (size_t k = 0; k < subs.size(); ++k) {
+            entry.subs.push_back(names[subs[k]->get_name()]);
+            entry.optional.push_back(subs[k]->is_optional());
+        }
+    }
 
-    if (it != __mValues.end()){
-        return (it->second).c_str();
+    size_t npos = (size_t)-1;
+    size_t size = 4;
+    while (size < 4 * __mEntries.size()) {
+        size <<= 1;
     }
-    else {
+    for (__mSeed = 0; ; ++__mSeed) {
+        // Grow the table if no seed is found soon
+        if (__mSeed && !(__mSeed % 1024)) {
+            size <<= 1;
+        }
+        __mSlots.assign(size, npos);
+        size_t i = 0;
+        for (; i < __mEntries.size(); ++i) {
+            size_t slot = __hash(__mEntries[i].name, __mSeed) & (size - 1);
+            if (__mSlots[slot] != npos) {
+                break;
+            }
+            __mSlots[slot] = i;
+        }
+        if (i == __mEntries.size()) {
+            break;
+        }
+    }
+
+    __mCmd.values.clear();
+    __mCmd.given.clear();
+    __mIndexed = true;
+}
+
+// Entry of the name, -1 if not exists
+size_t Cli::__find(std::string_view name)
+{
+    if (!__mIndexed) {
+        __build_index();
+    }
+    size_t i = __mSlots[__hash(name, __mSeed) & (__mSlots.size() - 1)];
+    if ((i != (size_t)-1) && (__mEntries[i].name == name)) {
+        return i;
+    }
+    return (size_t)-1;
+}
+
+// Get value of given option
+const char* Cli::get_value(std::string_view option)
+{
+    size_t i = __find(option);
+    if ((i == (size_t)-1) || (i >= __mCurrent->values.size())) {
         return NULL;
     }
+    return __mCurrent->values[i];
+}
+
+// Get value of given option as number. Same as atoi, numbers
+// of any 32-bit id are parsed
+long long Cli::get_number(std::string_view option)
+{
+    const char* value = get_value(option);
+    long long number = 0;
+    if (value) {
+        std::from_chars(value, value + strlen(value), number);
+    }
+    return number;
 }
 
 // Clear parsed results
 void Cli::reset_values()
 {
-    __mValues.clear();
+    ParsedCmd& cmd = *__mCurrent;
+    for (size_t i = 0; i < cmd.given.size(); ++i) {
+        cmd.values[cmd.given[i]] = NULL;
+    }
+    cmd.given.clear();
 }
 
 // Parse commands
-bool Cli::parse_cmds(std::string& buf)
+bool Cli::parse_cmds(std::string_view buf)
 {
-    // Spiliting the arguments
-    std::istringstream instr(buf);
-    StringList argv;
-    std::string s;
-    while(instr >> s){
-        argv.push_back(s);
+    if (!parse(buf, __mCmd)) {
+        usage();
     }
-    int argc = argv.size();
+    return use_cmd(__mCmd);
+}
 
-    // Check for all command names in given input
-    std::map<std::string, bool>::iterator nIter = __mCmdNames.begin();
+bool Cli::use_cmd(ParsedCmd& cmd)
+{
+    __mCurrent = &cmd;
+    if (cmd.error.size()) {
+        std::cout << cmd.error;
+        return false;
+    }
+    return true;
+}
 
-    for (; nIter != __mCmdNames.end(); ++nIter ){
-        // If it is exists
-        std::string name;
-        size_t pos = (nIter->first).find(" ");
-        if (pos != std::string::npos) {
-            name = (nIter->first).substr(pos+1);
+// Parse the command line. The line is split in place, in a copy of
+// it, so the values refer the copy and nothing is allocated per token
+bool Cli::parse(std::string_view buf, ParsedCmd& cmd)
+{
+    if (!__mIndexed) {
+        __build_index();
+    }
+    if (cmd.values.size() != __mEntries.size()) {
+        cmd.values.assign(__mEntries.size(), NULL);
+        cmd.given.clear();
+    }
+    for (size_t i = 0; i < cmd.given.size(); ++i) {
+        cmd.values[cmd.given[i]] = NULL;
+    }
+    cmd.given.clear();
+    cmd.error.clear();
+    cmd.line.assign(buf.data(), buf.size());
+
+    char* p = &cmd.line[0];
+    char* end = p + cmd.line.size();
+    size_t npos = (size_t)-1;
+    size_t pending = npos;       // Option waiting for its value
+    while (true) {
+        // Spiliting the arguments
+        while ((p != end) && isspace((unsigned char)*p)) {
+            *p++ = '\0';
         }
-        else {
-            name = (nIter->first);
+        if (p == end) {
+            break;
+        }
+        char* token = p;
+        while ((p != end) && !isspace((unsigned char)*p)) {
+            ++p;
+        }
+        std::string_view name(token, p - token);
+        if (p != end) {
+            *p++ = '\0';
         }
 
-        if (std::find(argv.begin(), argv.end(), name) != argv.end()) {
-            // If the value is not required
-            if(!nIter->second) {
-                // Update value as empty
-                __mValues.insert(std::pair<std::string, std::string>
-                        (name, ""));
-            }
-            else { // If required get the value from input
-                const char * value = get_cmd_value(argv, name);
-                if (value) {
-                    std::string sval(value);
-                    __mValues.insert(std::pair<std::string, std::string>(name, sval));
-                }
-                else{ //If value is missing issue the error
-                    std::cout << "\nError : Missing argument for " << name << "\n";
-                    return false;
-                }
-            }
+        // Value is the token next to the option
+        if (pending != npos) {
+            cmd.values[pending] = token;
+            pending = npos;
         }
+
+        // Check the token is a command name not given already
+        size_t i = __find(name);
+        if ((i == npos) || cmd.values[i]) {
+            continue;
+        }
+        cmd.given.push_back(i);
+        // Update value as empty, till the value is found
+        cmd.values[i] = "";
+        if (__mEntries[i].required) {
+            pending = i;
+        }
+    }
+
+    //If value is missing issue the error
+    if (pending != npos) {
+        cmd.error = "\nError : Missing argument for ";
+        cmd.error.append(__mEntries[pending].name).append("\n");
+        return false;
     }
 
     // If some options is updated, then look for
     // sub options of all titles
-    if (__mValues.size()) {
-        return validate_title_sub_options();
+    if (cmd.given.size()) {
+        return validate_title_sub_options(cmd);
     }
     else { // If notning is upated, then it is in valid arguments
-        std::cout << "\nError : Invalid argument is given\n";
-        usage();
+        cmd.error = "\nError : Invalid argument is given\n";
         return false;
     }
 }
 
+/**********************************************************************
+ *                     CmdQueue class methods                         *
+ **********************************************************************/
+// Spin for a while, then sleep so that a waiting thread does not
+// take the core from the other one
+void CmdQueue::__pause(size_t& spins)
+{
+    if (++spins < 64) {
+        std::this_thread::yield();
+    }
+    else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+ParsedCmd& CmdQueue::back()
+{
+    size_t tail = __mTail.load(std::memory_order_relaxed);
+    size_t spins = 0;
+    while (tail - __mHead.load(std::memory_order_acquire) == __mSlots.size()) {
+        __pause(spins);
+    }
+    return __mSlots[tail % __mSlots.size()];
+}
+
+void CmdQueue::push()
+{
+    __mTail.store(__mTail.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+}
+
+ParsedCmd* CmdQueue::front()
+{
+    size_t head = __mHead.load(std::memory_order_relaxed);
+    size_t spins = 0;
+    while (head == __mTail.load(std::memory_order_acquire)) {
+        // Commands pushed before closing are still read
+        if (__mClosed.load(std::memory_order_acquire) &&
+                (head == __mTail.load(std::memory_order_acquire))) {
+            return NULL;
+        }
+        __pause(spins);
+    }
+    return &__mSlots[head % __mSlots.size()];
+}
+
+void CmdQueue::pop()
+{
+    __mHead.store(__mHead.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+}
+
+void CmdQueue::close()
+{
+    __mClosed.store(true, std::memory_order_release);
+}
+
 /**********************************************************************
  *                     Utility Cli Functions                          *
  **********************************************************************/
@@ -340,6 +563,19 @@ void update_available_option(Cli* cli)
     cli->add_title_sub_option(title, "-dest_node", "", "DEST_NODE_ID", true);
     cli->add_title_sub_option(title, "-weight", "", "WEIGHT", true);
 
+    // Load edges from file
+    title = cli->add_title("load_graph",
+            "Add all edges given in the file (edge list or DIMACS)");
+    cli->add_title_sub_option(title, "-file", "", "FILE_NAME", true);
+
+    // Save graph as image and open it
+    title = cli->add_title("save_graph",
+            "Save the graph as binary image to be opened by open_graph");
+    cli->add_title_sub_option(title, "-file", "", "FILE_NAME", true);
+    title = cli->add_title("open_graph",
+            "Open the graph image read-only (in place of create_graph)");
+    cli->add_title_sub_option(title, "-file", "", "FILE_NAME", true);
+
     // Delete Edge
     title = cli->add_title("delete_edge", "Delete the given edge from the graph");
     cli->add_title_sub_option(title, "-src_node", "", "SRC_NODE_ID", true);
@@ -351,6 +587,51 @@ void update_available_option(Cli* cli)
     cli->add_title_sub_option(title, "-src_node", "", "SRC_NODE_ID", true);
     cli->add_title_sub_option(title, "-dest_node", "", "DEST_NODE_ID", true);
     cli->add_title_sub_option(title, "-time", "", "DURATION", true);
+    cli->add_title_sub_option(title, "-max_paths", "", "MAX_PATHS", true, true);
+    cli->add_title_sub_option(title, "-path_order", "", "ORDER", true, true);
+    cli->add_title_sub_option(title, "-path_time", "", "MS", true, true);
+    cli->add_title_sub_option(title, "-threads", "", "THREADS", true, true);
+    cli->add_title_sub_option(title, "-format", "", "FORMAT", true, true);
+    cli->add_title_sub_option(title, "-every", "", "CYCLES", true, true);
+    cli->add_title_sub_option(title, "-window", "", "CYCLES", true, true);
+    cli->add_title_sub_option(title, "-ratio", "", "", false, true);
+    cli->add_title_sub_option(title, "-stats_file", "", "FILE_NAME", true, true);
+
+    // Add flow to be started with other flows
+    title = cli->add_title("add_flow",
+            "Add data flow b/w src and dest to be started by start_flows");
+    cli->add_title_sub_option(title, "-src_node", "", "SRC_NODE_ID", true);
+    cli->add_title_sub_option(title, "-dest_node", "", "DEST_NODE_ID", true);
+
+    // start all added flows
+    title = cli->add_title("start_flows",
+            "Start all added flows together for given duration (in sec)");
+    cli->add_title_sub_option(title, "-time", "", "DURATION", true);
+    cli->add_title_sub_option(title, "-max_paths", "", "MAX_PATHS", true, true);
+    cli->add_title_sub_option(title, "-path_order", "", "ORDER", true, true);
+    cli->add_title_sub_option(title, "-path_time", "", "MS", true, true);
+    cli->add_title_sub_option(title, "-threads", "", "THREADS", true, true);
+    cli->add_title_sub_option(title, "-format", "", "FORMAT", true, true);
+    cli->add_title_sub_option(title, "-every", "", "CYCLES", true, true);
+    cli->add_title_sub_option(title, "-window", "", "CYCLES", true, true);
+    cli->add_title_sub_option(title, "-ratio", "", "", false, true);
+    cli->add_title_sub_option(title, "-stats_file", "", "FILE_NAME", true, true);
+
+    // Max flow b/w src and dest
+    title = cli->add_title("max_flow",
+            "Print the max flow b/w src and dest and a min cut");
+    cli->add_title_sub_option(title, "-src_node", "", "SRC_NODE_ID", true);
+    cli->add_title_sub_option(title, "-dest_node", "", "DEST_NODE_ID", true);
+
+    // No of paths b/w src and dest
+    title = cli->add_title("count_paths",
+            "Print the no of simple paths b/w src and dest");
+    cli->add_title_sub_option(title, "-src_node", "", "SRC_NODE_ID", true);
+    cli->add_title_sub_option(title, "-dest_node", "", "DEST_NODE_ID", true);
+
+    // Instrumentation of the simulation
+    cli->add_flag("stats",
+            "Print the time and work of each phase of the simulation");
 
     // More commands can be added
 }
@@ -7,8 +7,13 @@
 # include <vector>
 # include <map>
 # include <string>
+# include <string_view>
+# include <charconv>
 # include <string.h>
 # include <algorithm>
+# include <atomic>
+# include <thread>
+# include <chrono>
 
 /*
  * Base class for all command line options
@@ -67,22 +72,26 @@ class Option : public Cmd
     private:
         std::string __mShortDesc;  // Short description for value (e.g. [NODE_ID])
         bool __mRequiredValue;     // Value required or not
+        bool __mOptional;          // Sub option can be omitted or not
 
     public:
         Option(const std::string& name,
                 const std::string& desc,
                 const std::string& short_desc,
-                bool required = true)
+                bool required = true,
+                bool optional = false)
             :
                 Cmd(name, desc)
         {
             __mShortDesc = short_desc;
             __mRequiredValue = required;
+            __mOptional = optional;
         }
         ~Option(){};
 
         std::string& get_usage();
         bool is_required();
+        bool is_optional();
 };
 
 /*
@@ -109,11 +118,80 @@ class Title : virtual public Cmd
 
         // Method to add suboption
         void add_sub_option(const std::string& name, const std::string& desc,
-                const std::string& short_desc, bool required);
+                const std::string& short_desc, bool required,
+                bool optional = false);
+        const std::vector<Option*>& get_sub_options();
 };
 
 typedef std::vector<std::string> StringList;
-typedef std::map<std::string, std::string> StringMap;
+
+/*
+ *  Name recognised by the parser. Sub options of different titles
+ *  with same name share the entry
+ */
+struct CmdEntry
+{
+    std::string name;              // Name as given in input
+    bool required;                 // Value required or not
+    Title* title;                  // Title of this name (NULL if not)
+    std::vector<size_t> subs;      // Entries of the title's sub options
+    std::vector<bool> optional;    // Sub option can be omitted or not
+
+    CmdEntry(const std::string& cmd_name, bool value_required)
+        :
+            name(cmd_name),
+            required(value_required),
+            title(NULL)
+    { }
+};
+
+/*
+ *  Command parsed from a line. The values point into the copy of
+ *  the line kept here, so a command can be parsed ahead of its
+ *  execution
+ */
+struct ParsedCmd
+{
+    std::string line;                  // Tokens of input
+    std::vector<const char*> values;   // Value of each entry (NULL if not given)
+    std::vector<size_t> given;         // Entries given
+    std::string error;                 // Error found by parser
+};
+
+/*
+ *  Lock-free queue of parsed commands b/w one parser and one
+ *  executor thread. The slots are reused, so their buffers are
+ *  allocated only once
+ */
+class CmdQueue
+{
+    private:
+        std::vector<ParsedCmd> __mSlots;
+        std::atomic<size_t> __mHead;      // Next slot to be read
+        std::atomic<size_t> __mTail;      // Next slot to be written
+        std::atomic<bool> __mClosed;      // No more commands
+
+    public:
+        CmdQueue(size_t size)
+            :
+                __mSlots(size),
+                __mHead(0),
+                __mTail(0),
+                __mClosed(false)
+        { }
+
+        // Slot to be written by parser. Waits while the queue is full
+        ParsedCmd& back();
+        void push();
+        // Next command to be executed. Waits while the queue is empty;
+        // NULL once it is closed and empty
+        ParsedCmd* front();
+        void pop();
+        void close();
+
+    private:
+        static void __pause(size_t& spins);
+};
 
 /*
  *  Singleton class to have all commands
@@ -128,11 +206,18 @@ class Cli
         static Cli* __mPrivateInstance;                   // private instance
         std::map<std::string, bool> __mCmdNames;          // map of all options vs its
         // required flag field
-        StringMap  __mValues;                             // Map of names and its value
-        // will be updated after parsing
+        // Parser index. The entries are hashed with a seed that maps
+        // each name to a slot of its own, so a lookup is one hash and
+        // one compare. Rebuilt when a command is added
+        std::vector<CmdEntry> __mEntries;                 // Names of parser
+        std::vector<size_t> __mSlots;                     // Entry of each slot
+        size_t __mSeed;                                   // Seed of the hash
+        bool __mIndexed;                                  // Index is built
+        ParsedCmd __mCmd;                                 // Parsed by parse_cmds
+        ParsedCmd* __mCurrent;                            // Values of get_value
         // Hiding constructors
     private:
-        Cli() { }
+        Cli() : __mSeed(0), __mIndexed(false), __mCurrent(&__mCmd) { }
         Cli(Cli const&){}
         Cli& operator=(Cli const&){}
         ~Cli(){}
@@ -151,7 +236,8 @@ class Cli
         void add_title_sub_option(Title *, const std::string& name,
                 const std::string& desc,
                 const std::string& short_desc,
-                bool required);
+                bool required,
+                bool optional = false);
 
         // Overloaded version of get cmd value
         const char* get_cmd_value(char** arg_start, char** arg_end,
@@ -163,13 +249,26 @@ class Cli
         // To get the usage string
         std::string& usage();
         // To validate sub options of title command
-        bool validate_title_sub_options();
+        bool validate_title_sub_options(ParsedCmd& cmd);
         // To get value of command
-        const char* get_value(const std::string& option);
+        const char* get_value(std::string_view option);
+        // Value of command as number (0 if not given or invalid)
+        long long get_number(std::string_view option);
         // Reset parser results
         void reset_values();
         // parsing user inputs
-        bool parse_cmds(std::string&);
+        bool parse_cmds(std::string_view buf);
+        // Parse into the given command, without printing the errors.
+        // Can be run in other thread than the one that uses the values
+        bool parse(std::string_view buf, ParsedCmd& cmd);
+        // Get the values from the parsed command. Prints the error
+        // found by parser, if any
+        bool use_cmd(ParsedCmd& cmd);
+
+    private:
+        void __build_index();
+        static size_t __hash(std::string_view name, size_t seed);
+        size_t __find(std::string_view name);
 };
 
 // Update command static information
@@ -0,0 +1,129 @@
+# include "cli.hpp"
+# include "graph.hpp"
+# include <random>
+
+// Random cases checked against the round based loop
+# define SPLIT_TEST_CASES 300000
+# define SPLIT_TEST_MAX_DEGREE 40
+
+static std::mt19937 gRandom;
+
+// The round based loop that Simulation::equal_split replaces: pkt_divide
+// (no_pkt_tbs / count, at least 1) pkts are sent to each edge in rounds
+// until the pkts or the capacity is exhausted
+size_t round_split(const EdgeWeight* weights, size_t out_edge_cout,
+        size_t no_pkt_tbs, size_t* transferred)
+{
+    size_t out_capacity = 0;
+    size_t actual_pkt_tbs = no_pkt_tbs;
+    for(size_t k = 0; k < out_edge_cout; ++k) {
+        transferred[k] = 0;
+        out_capacity += weights[k];
+    }
+    while(no_pkt_tbs && out_capacity) {
+        size_t pkt_divide = no_pkt_tbs/out_edge_cout;
+        for(size_t k = 0; k < out_edge_cout; ++k) {
+            if(pkt_divide == 0) {
+                pkt_divide = 1;
+            }
+            size_t current_weight = weights[k] - transferred[k];
+            size_t pkt_to_send = (current_weight > pkt_divide) ?
+                pkt_divide : current_weight;
+            transferred[k] += pkt_to_send;
+            no_pkt_tbs -= pkt_to_send;
+            out_capacity -= pkt_to_send;
+            if((!no_pkt_tbs) || (!out_capacity)) {
+                break;
+            }
+        }
+    }
+    return actual_pkt_tbs - no_pkt_tbs;
+}
+
+// Weight of an edge, zero or small or large
+EdgeWeight random_weight()
+{
+    switch (gRandom() % 4) {
+        case 0:
+            return 0;
+        case 1:
+            return gRandom() % 4;
+        case 2:
+            return gRandom() % 50;
+        default:
+            return gRandom() % 2000;
+    }
+}
+
+// Pkts to be sent, from none to more than the out capacity
+size_t random_pkts(size_t out_capacity)
+{
+    switch (gRandom() % 5) {
+        case 0:
+            return INFINITY;
+        case 1:
+            return gRandom() % 4;
+        case 2:
+            return out_capacity;
+        default:
+            return gRandom() % (2 * out_capacity + 2);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Cli *cli = Cli::Instance();
+    char** end = argv + argc;
+    size_t cases = SPLIT_TEST_CASES;
+    const char* value;
+    if ((value = cli->get_cmd_value(argv, end, "-cases"))) {
+        cases = atoi(value);
+    }
+    if ((value = cli->get_cmd_value(argv, end, "-seed"))) {
+        gRandom.seed(atoi(value));
+    }
+
+    std::vector<EdgeWeight> weights;
+    std::vector<EdgeWeight> scratch;
+    std::vector<size_t> expected;
+    std::vector<size_t> pkts;
+    size_t failed = 0;
+    for (size_t c = 0; c < cases; ++c) {
+        size_t count = 1 + gRandom() % SPLIT_TEST_MAX_DEGREE;
+        weights.resize(count);
+        scratch.resize(count);
+        expected.resize(count);
+        pkts.resize(count);
+        size_t out_capacity = 0;
+        for (size_t k = 0; k < count; ++k) {
+            weights[k] = random_weight();
+            out_capacity += weights[k];
+        }
+        size_t no_pkt_tbs = random_pkts(out_capacity);
+
+        size_t sent = round_split(weights.data(), count, no_pkt_tbs,
+                expected.data());
+        size_t split = Simulation::equal_split(weights.data(), count,
+                no_pkt_tbs, pkts.data(), scratch.data());
+        if ((sent == split) && (expected == pkts)) {
+            continue;
+        }
+        if (++failed <= 10) {
+            std::cout << "Mismatch: pkts " << no_pkt_tbs << " weights";
+            for (size_t k = 0; k < count; ++k) {
+                std::cout << " " << weights[k];
+            }
+            std::cout << "\n  rounds  " << sent << " :";
+            for (size_t k = 0; k < count; ++k) {
+                std::cout << " " << expected[k];
+            }
+            std::cout << "\n  split   " << split << " :";
+            for (size_t k = 0; k < count; ++k) {
+                std::cout << " " << pkts[k];
+            }
+            std::cout << "\n";
+        }
+    }
+    std::cout << cases << " cases, " << failed << " failed\n";
+    return failed ? 1 : 0;
+}
@@ -3,6 +3,11 @@
 /**********************************************************************
  *                     Edge class methods                             *
  **********************************************************************/
+size_t Edge::get_index()
+{
+    return __mIndex;
+}
+
 Node* Edge::get_source_node()
 {
     return __mSrc;
@@ -53,17 +58,6 @@ bool Edge::is_having_node(Node *node)
     return false;
 }
 
-void Edge::print_statistics()
-{
-    std::string  edge;
-    edge.append(itos(__mSrc->getId()));
-    edge.append("--->");
-    edge.append(itos(__mDest->getId()));
-    Log::_mCout << center(edge,20) << _mDelimiter;
-    Log::_mCout << center(Log::itos(__mWeight),18) << _mDelimiter;
-    Log::_mCout << *(dynamic_cast<EdgeSimualtionProperty*>(this));
-}
-
 /**********************************************************************
  *                     Node class methods                               *
  **********************************************************************/
@@ -72,6 +66,11 @@ NodeID& Node::getId()
     return __mId;
 }
 
+size_t Node::get_index()
+{
+    return __mIndex;
+}
+
 void Node::set_visited(bool mVisited_flag=true)
 {
     __mVisited = mVisited_flag;
@@ -84,21 +83,76 @@ bool Node::is_visited()
 
 void Node::add_incoming_edge(Edge* in_edge)
 {
+    in_edge->__mInPos = __mInEdges.size();
     __mInEdges.push_back(in_edge);
 }
 
 void Node::add_outgoing_edge(Edge* out_edge)
 {
+    out_edge->__mOutPos = __mOutEdges.size();
     __mOutEdges.push_back(out_edge);
 }
 
+// The edge is left as NULL. The list is compacted when it is used,
+// or when half of it is NULL
+void Node::remove_incoming_edge(Edge* in_edge)
+{
+    __mInEdges[in_edge->__mInPos] = NULL;
+    if (2 * ++__mInHoles > __mInEdges.size()) {
+        __compact();
+    }
+}
+
+void Node::remove_outgoing_edge(Edge* out_edge)
+{
+    __mOutEdges[out_edge->__mOutPos] = NULL;
+    if (2 * ++__mOutHoles > __mOutEdges.size()) {
+        __compact();
+    }
+}
+
+// Remove the NULL left by removed edges, keeping the order of edges
+void Node::__compact()
+{
+    if (__mInHoles) {
+        size_t count = 0;
+        for (size_t i = 0; i < __mInEdges.size(); ++i) {
+            if (__mInEdges[i]) {
+                __mInEdges[i]->__mInPos = count;
+                __mInEdges[count++] = __mInEdges[i];
+            }
+        }
+        __mInEdges.resize(count);
+        __mInHoles = 0;
+    }
+    if (__mOutHoles) {
+        size_t count = 0;
+        for (size_t i = 0; i < __mOutEdges.size(); ++i) {
+            if (__mOutEdges[i]) {
+                __mOutEdges[i]->__mOutPos = count;
+                __mOutEdges[count++] = __mOutEdges[i];
+            }
+        }
+        __mOutEdges.resize(count);
+        __mOutHoles = 0;
+    }
+}
+
+// Make room for more edges
+void Node::reserve_edges(size_t in_edges, size_t out_edges)
+{
+    __mInEdges.reserve(__mInEdges.size() + in_edges);
+    __mOutEdges.reserve(__mOutEdges.size() + out_edges);
+}
+
 // Remove the edges that links to given node
 void Node::remove_edge_with_node(Node& anode, ADJNODETYPE type=ALL)
 {
+    __compact();
     if((type == IN)||(type == ALL)) {
         for (int i= 0; i < __mInEdges.size(); ++i) {
             if (__mInEdges[i]->is_node_src(&anode)) {
-                __mInEdges.erase(__mInEdges.begin()+i);
+                remove_incoming_edge(__mInEdges[i]);
                 break;
             }
         }
@@ -106,7 +160,7 @@ void Node::remove_edge_with_node(Node& anode, ADJNODETYPE type=ALL)
     if((type == OUT)||(type == ALL)) {
         for (int i= 0; i < __mOutEdges.size(); ++i) {
             if (__mOutEdges[i]->is_node_dest(&anode)) {
-                __mOutEdges.erase(__mOutEdges.begin()+i);
+                remove_outgoing_edge(__mOutEdges[i]);
                 break;
             }
         }
@@ -117,6 +171,7 @@ void Node::remove_edge_with_node(Node& anode, ADJNODETYPE type=ALL)
 // Can be OUT, IN, ALL
 NodeIDList Node::get_adjency_list(ADJNODETYPE nType=ALL)
 {
+    __compact();
     NodeIDList adj_list;
     if (nType == IN || nType == ALL){
         for (int i=0; i < __mInEdges.size(); ++i) {
@@ -138,11 +193,14 @@ void Node::unlink_all_edges()
 {
     __mInEdges.clear();
     __mOutEdges.clear();
+    __mInHoles = 0;
+    __mOutHoles = 0;
 }
 
 // Get the summation of capacity of all outgoing edges.
 size_t Node::get_out_edges_capacity()
 {
+    __compact();
     size_t capacity = 0;
     for (int i=0; i < __mOutEdges.size(); ++i) {
         capacity += __mOutEdges[i]->get_weight();
@@ -153,6 +211,7 @@ size_t Node::get_out_edges_capacity()
 // Get the summation of capacity of all incoming edges.
 size_t Node::get_in_edges_capacity()
 {
+    __compact();
     size_t capacity = 0;
     for (int i=0; i < __mInEdges.size(); ++i) {
         capacity += __mInEdges[i]->get_weight();
@@ -163,6 +222,7 @@ size_t Node::get_in_edges_capacity()
 //Get the edge that links the current node with given node
 Edge* Node::get_edge_with_node(Node &node, ADJNODETYPE type=ALL)
 {
+    __compact();
     if((type == IN)||(type == ALL)) {
         for (int i= 0; i < __mInEdges.size(); ++i) {
             if (__mInEdges[i]->is_node_src(&node)) {
@@ -181,43 +241,165 @@ Edge* Node::get_edge_with_node(Node &node, ADJNODETYPE type=ALL)
     return NULL;
 }
 
-// print the node statistics
-void Node::print_statistics()
-{
-    Log::_mCout << Log::center(Log::itos(__mId), 10) << _mDelimiter;
-    Log::_mCout << *(dynamic_cast<NodeSimualtionProperty*>(this));
-
-}
-
 // Get the out edges list
-EdgeList Node::get_out_edge_list()
+const EdgeList& Node::get_out_edge_list()
 {
+    __compact();
     return __mOutEdges;
 }
 
 // Get the in edges list
-EdgeList Node::get_in_edge_list()
+const EdgeList& Node::get_in_edge_list()
 {
+    __compact();
     return __mInEdges;
 }
 
-void Node::reset_edge_counters()
+/**********************************************************************
+ *                     HashIndex class methods                        *
+ **********************************************************************/
+const uint64_t HashIndex::NONE;
+
+// Mix the bits of key (splitmix64 finalizer)
+uint64_t HashIndex::hash(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+uint64_t HashIndex::find(uint64_t key) const
 {
-    for (int i=0; i < __mInEdges.size(); ++i) {
-        __mInEdges[i]->set_no_of_pkts_transferred(0);
-        __mInEdges[i]->set_total_pkts_transferred(0);
+    if (__mSlots.empty()) {
+        return NONE;
     }
+    size_t mask = __mSlots.size() - 1;
+    for (size_t i = hash(key) & mask; ; i = (i + 1) & mask) {
+        if (__mSlots[i].key == key) {
+            return __mSlots[i].value;
+        }
+        if (__mSlots[i].key == NONE) {
+            return NONE;
+        }
+    }
+}
 
-    for (int i=0; i < __mOutEdges.size(); ++i) {
-        __mOutEdges[i]->set_no_of_pkts_transferred(0);
-        __mOutEdges[i]->set_total_pkts_transferred(0);
+void HashIndex::insert(uint64_t key, uint64_t value)
+{
+    // At most half of the slots are used
+    if (2 * (__mCount + 1) > __mSlots.size()) {
+        __rehash(std::max((size_t)16, 2 * __mSlots.size()));
+    }
+    size_t mask = __mSlots.size() - 1;
+    size_t i = hash(key) & mask;
+    while ((__mSlots[i].key != NONE) && (__mSlots[i].key != key)) {
+        i = (i + 1) & mask;
+    }
+    if (__mSlots[i].key == NONE) {
+        ++__mCount;
+    }
+    __mSlots[i].key = key;
+    __mSlots[i].value = value;
+}
+
+void HashIndex::erase(uint64_t key)
+{
+    if (__mSlots.empty()) {
+        return;
+    }
+    size_t mask = __mSlots.size() - 1;
+    size_t i = hash(key) & mask;
+    while (__mSlots[i].key != key) {
+        if (__mSlots[i].key == NONE) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    --__mCount;
+
+    // Shift back the keys that can't be found past the hole
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (__mSlots[j].key == NONE) {
+            break;
+        }
+        size_t home = hash(__mSlots[j].key) & mask;
+        // Key at j stays if its home is in (i, j]
+        if (((j - home) & mask) < ((j - i) & mask)) {
+            continue;
+        }
+        __mSlots[i] = __mSlots[j];
+        i = j;
+    }
+    __mSlots[i].key = NONE;
+}
+
+void HashIndex::reserve(size_t count)
+{
+    size_t size = 16;
+    while (size < 2 * count) {
+        size <<= 1;
     }
+    if (size > __mSlots.size()) {
+        __rehash(size);
+    }
+}
+
+void HashIndex::get_entries(
+        std::vector<std::pair<uint64_t, uint64_t> >& entries) const
+{
+    entries.clear();
+    entries.reserve(__mCount);
+    for (size_t i = 0; i < __mSlots.size(); ++i) {
+        if (__mSlots[i].key != NONE) {
+            entries.push_back(std::make_pair(__mSlots[i].key,
+                        __mSlots[i].value));
+        }
+    }
+}
 
+void HashIndex::__rehash(size_t size)
+{
+    std::vector<Slot> slots(size);
+    for (size_t i = 0; i < size; ++i) {
+        slots[i].key = NONE;
+    }
+    slots.swap(__mSlots);
+    size_t mask = size - 1;
+    for (size_t k = 0; k < slots.size(); ++k) {
+        if (slots[k].key != NONE) {
+            size_t i = hash(slots[k].key) & mask;
+            while (__mSlots[i].key != NONE) {
+                i = (i + 1) & mask;
+            }
+            __mSlots[i] = slots[k];
+        }
+    }
 }
 
 /**********************************************************************
  *                     Graph class methods                              *
  **********************************************************************/
+Graph::~Graph()
+{
+    delete __mImage;
+}
+
+// Build the image of the graph if it is changed since last freeze
+GraphImage& Graph::freeze()
+{
+    if (__mImage == NULL) {
+        __mImage = new GraphImage();
+    }
+    if (__mChanged) {
+        __mImage->build(*this);
+        __mChanged = false;
+    }
+    return *__mImage;
+}
 
 // Add new edge in the current graph. If source or destination
 // nodes are not exist then it will create node first and create
@@ -226,6 +408,11 @@ void Graph::add_edge(NodeID src_id, NodeID dest_id, EdgeWeight weight)
 {
     Node* src = get_node_from_id(src_id);
     Node* dest = get_node_from_id(dest_id);
+    // New edge can't be added if maximum edges are added already
+    if(!__mEdgeSlab.available() && !(src && dest && get_edge(*src, *dest))){
+        std::cout << "\nError: Maximum edges are added already\n";
+        return;
+    }
     // Add source and destination node if not exists
     if(src == NULL){
         if(!add_node(src_id)){
@@ -241,9 +428,9 @@ void Graph::add_edge(NodeID src_id, NodeID dest_id, EdgeWeight weight)
     }
 
     // Create edage
-    Edge* edge = src->get_edge_with_node(*dest, OUT);
+    Edge* edge = get_edge(*src, *dest);
     if(edge == NULL){
-        edge = new Edge(weight, src, dest);
+        edge = __new_edge(weight, src, dest);
         // Updating edges information in nodes
         src->add_outgoing_edge(edge);
         dest->add_incoming_edge(edge);
@@ -252,17 +439,346 @@ void Graph::add_edge(NodeID src_id, NodeID dest_id, EdgeWeight weight)
         std::cout << "\nInfo: Edge already exists.";
         std::cout << " Updating weight to given value\n";
         edge->set_weight(weight);
+        __mChanged = true;
+    }
+}
+
+// Create node in its slab and index it
+Node* Graph::__new_node(NodeID node_id)
+{
+    size_t slot = __mNodeSlab.allocate();
+    __mChanged = true;
+    __mNodeIndex.insert(node_id, slot);
+    return new (__mNodeSlab.get(slot)) Node(node_id, slot, &__mPool);
+}
+
+// Create edge in its slab and index it
+Edge* Graph::__new_edge(EdgeWeight weight, Node* src, Node* dest)
+{
+    size_t slot = __mEdgeSlab.allocate();
+    __mChanged = true;
+    __mEdgeIndex.insert(__edge_key(*src, *dest), slot);
+    return new (__mEdgeSlab.get(slot)) Edge(weight, src, dest, slot);
+}
+
+// Free the edge unlinked from its nodes
+void Graph::__free_edge(Edge* edge)
+{
+    __mEdgeIndex.erase(__edge_key(*edge->get_source_node(),
+                *edge->get_destination_node()));
+    __mCounters.clear_edge(edge->get_index());
+    __mEdgeSlab.free(edge->get_index());
+    __mChanged = true;
+}
+
+uint64_t Graph::__edge_key(Node& src_node, Node& dest_node)
+{
+    return ((uint64_t)src_node.get_index() << 32) | dest_node.get_index();
+}
+
+// Get the edge b/w src and dest, NULL if not exists
+Edge* Graph::get_edge(Node& src_node, Node& dest_node)
+{
+    uint64_t slot = __mEdgeIndex.find(__edge_key(src_node, dest_node));
+    return (slot == HashIndex::NONE) ? NULL : __mEdgeSlab.get(slot);
+}
+
+// Add the edges given in the file, one per line. Lines can be
+//     <SRC> <DEST> [<WEIGHT>]       (edge list, weight is 1 by default)
+//     a <SRC> <DEST> <WEIGHT>       (DIMACS arc)
+// DIMACS comment/problem lines and lines starting with # or % are
+// skipped. The nodes are added if not exist. As with add_edge, the
+// weight of an existing edge is updated and the edges are added in
+// order of the file
+bool Graph::load_edges(const char* file)
+{
+    // Read the whole file. Size is known only for a regular file
+    struct stat st;
+    std::ifstream infile(file, std::ifstream::binary);
+    if(infile.fail() || (stat(file, &st) != 0) || !S_ISREG(st.st_mode)) {
+        std::cout << "\nError: Failed to open file " << file << "\n";
+        return false;
+    }
+    std::string buf(st.st_size, '\0');
+    if (!infile.read(&buf[0], buf.size())) {
+        std::cout << "\nError: Failed to open file " << file << "\n";
+        return false;
+    }
+
+    // Parse the chunks of the file (split at line end) in parallel
+    size_t chunks = std::max(1u, std::thread::hardware_concurrency());
+    chunks = std::min(chunks, buf.size() / (1 << 20) + 1);
+    std::vector<const char*> bounds(chunks + 1, buf.data() + buf.size());
+    bounds[0] = buf.data();
+    for (size_t c = 1; c < chunks; ++c) {
+        const char* p = buf.data() + (buf.size() * c) / chunks;
+        p = std::find(std::max(p, bounds[c-1]), bounds[chunks], '\n');
+        bounds[c] = (p == bounds[chunks]) ? p : p + 1;
+    }
+    std::vector<std::vector<EdgeEntry> > parsed(chunks);
+    std::vector<const char*> errors(chunks);
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < chunks; ++c) {
+        threads.push_back(std::thread([&, c]() {
+            errors[c] = __parse_edges(bounds[c], bounds[c+1], parsed[c]);
+        }));
+    }
+    for (size_t c = 0; c < chunks; ++c) {
+        threads[c].join();
+    }
+    for (size_t c = 0; c < chunks; ++c) {
+        if (errors[c]) {
+            std::cout << "\nError: Invalid edge at line "
+                << std::count((const char*)buf.data(), errors[c], '\n') + 1
+                << " of " << file << "\n";
+            return false;
+        }
+    }
+    std::string().swap(buf);
+
+    std::vector<EdgeEntry> edges;
+    for (size_t c = 0; c < chunks; ++c) {
+        edges.insert(edges.end(), parsed[c].begin(), parsed[c].end());
+        std::vector<EdgeEntry>().swap(parsed[c]);
+    }
+
+    // Nodes of the file in ascending id order. Ids are mostly dense,
+    // then a table of ids is used instead of sorting
+    NodeID max_id = 0;
+    for (size_t i = 0; i < edges.size(); ++i) {
+        max_id = std::max(max_id, std::max(edges[i].src, edges[i].dest));
+    }
+    const size_t NONE = (size_t)-1;
+    bool dense = edges.size() && ((size_t)max_id < 8 * edges.size());
+    std::vector<size_t> table;
+    NodeIDList ids;
+    if (dense) {
+        table.assign((size_t)max_id + 1, NONE);
+        for (size_t i = 0; i < edges.size(); ++i) {
+            table[edges[i].src] = 0;
+            table[edges[i].dest] = 0;
+        }
+        for (size_t id = 0; id < table.size(); ++id) {
+            if (table[id] == 0) {
+                table[id] = ids.size();
+                ids.push_back(id);
+            }
+        }
+    }
+    else {
+        ids.reserve(2 * edges.size());
+        for (size_t i = 0; i < edges.size(); ++i) {
+            ids.push_back(edges[i].src);
+            ids.push_back(edges[i].dest);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+
+    // Find the existing nodes
+    std::vector<Node*> nodes(ids.size(), NULL);
+    std::vector<bool> existing(ids.size(), false);
+    size_t new_nodes = 0;
+    for (size_t k = 0; k < ids.size(); ++k) {
+        nodes[k] = get_node_from_id(ids[k]);
+        if (nodes[k]) {
+            existing[k] = true;
+        }
+        else {
+            ++new_nodes;
+        }
     }
+    if(new_nodes > __mNodeSlab.available()){
+        std::cout << "\nError: File has more nodes than maximum nodes\n";
+        return false;
+    }
+
+    // Position of the nodes of each edge in ids
+    std::vector<size_t> src(edges.size());
+    std::vector<size_t> dest(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (dense) {
+            src[i] = table[edges[i].src];
+            dest[i] = table[edges[i].dest];
+        }
+        else {
+            src[i] = std::lower_bound(ids.begin(), ids.end(), edges[i].src)
+                - ids.begin();
+            dest[i] = std::lower_bound(ids.begin(), ids.end(), edges[i].dest)
+                - ids.begin();
+        }
+    }
+    std::vector<size_t>().swap(table);
+
+    // Group the edges by source (in order of file)
+    std::vector<size_t> offsets(ids.size() + 1, 0);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        ++offsets[src[i] + 1];
+    }
+    for (size_t k = 0; k < ids.size(); ++k) {
+        offsets[k+1] += offsets[k];
+    }
+    std::vector<size_t> by_src(edges.size());
+    std::vector<size_t> at(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        by_src[at[src[i]]++] = i;
+    }
+
+    // Find the duplicate edges of each source. The first one is added
+    // with the weight of the last one
+    std::vector<size_t> seen(ids.size(), NONE);     // Source seen last
+    std::vector<size_t> first(ids.size(), NONE);    // First edge to dest
+    std::vector<Edge*> old_edges(ids.size(), NULL); // Existing edge to dest
+    std::vector<bool> added(edges.size(), false);
+    std::vector<size_t> in_count(ids.size(), 0);
+    std::vector<size_t> out_count(ids.size(), 0);
+    std::vector<std::pair<Edge*, EdgeWeight> > updates;
+    size_t new_edges = 0;
+    size_t duplicates = 0;
+    for (size_t k = 0; k < ids.size(); ++k) {
+        if (existing[k]) {
+            const EdgeList& out_edges = nodes[k]->get_out_edge_list();
+            for (size_t j = 0; j < out_edges.size(); ++j) {
+                NodeID id = out_edges[j]->get_destination_node()->getId();
+                NodeIDList::iterator it = std::lower_bound(ids.begin(),
+                        ids.end(), id);
+                if (it != ids.end() && *it == id) {
+                    seen[it - ids.begin()] = k;
+                    first[it - ids.begin()] = NONE;
+                    old_edges[it - ids.begin()] = out_edges[j];
+                }
+            }
+        }
+        for (size_t j = offsets[k]; j < offsets[k+1]; ++j) {
+            size_t i = by_src[j];
+            size_t d = dest[i];
+            if (seen[d] != k) {
+                seen[d] = k;
+                first[d] = i;
+                added[i] = true;
+                ++new_edges;
+                ++out_count[k];
+                ++in_count[d];
+            }
+            else {
+                ++duplicates;
+                if (first[d] == NONE) {
+                    updates.push_back(std::make_pair(old_edges[d],
+                                edges[i].weight));
+                }
+                else {
+                    edges[first[d]].weight = edges[i].weight;
+                }
+            }
+        }
+    }
+
+    if(new_edges > __mEdgeSlab.available()){
+        std::cout << "\nError: File has more edges than maximum edges\n";
+        return false;
+    }
+
+    // The graph is changed only after all checks
+    __mNodeIndex.reserve(__mNodeIndex.size() + new_nodes);
+    for (size_t k = 0; k < ids.size(); ++k) {
+        if (nodes[k] == NULL) {
+            nodes[k] = __new_node(ids[k]);
+        }
+    }
+    for (size_t u = 0; u < updates.size(); ++u) {
+        updates[u].first->set_weight(updates[u].second);
+    }
+    __mChanged = true;
+
+    // Create the edges
+    __mEdgeIndex.reserve(__mEdgeIndex.size() + new_edges);
+    for (size_t k = 0; k < ids.size(); ++k) {
+        nodes[k]->reserve_edges(in_count[k], out_count[k]);
+    }
+    for (size_t i = 0; i < edges.size(); ++i) {
+        if (added[i]) {
+            Edge* edge = __new_edge(edges[i].weight, nodes[src[i]],
+                    nodes[dest[i]]);
+            nodes[src[i]]->add_outgoing_edge(edge);
+            nodes[dest[i]]->add_incoming_edge(edge);
+        }
+    }
+
+    if (duplicates) {
+        std::cout << "\nInfo: " << duplicates << " edges already exist.";
+        std::cout << " Updated weight to given value\n";
+    }
+    return true;
+}
+
+// Parse the edges in [begin, end). Returns the invalid line if any
+const char* Graph::__parse_edges(const char* begin, const char* end,
+        std::vector<EdgeEntry>& edges)
+{
+    edges.reserve((end - begin) / 12);
+    const char* p = begin;
+    while (p < end) {
+        const char* line = p;
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        // Skip empty, comment and problem lines
+        if (p == end || *p == '\n' || *p == '#' || *p == '%' ||
+                *p == 'c' || *p == 'p') {
+            p = std::find(p, end, '\n');
+            if (p < end) {
+                ++p;
+            }
+            continue;
+        }
+        bool arc = (*p == 'a');
+        if (arc) {
+            ++p;
+        }
+
+        size_t values[3] = {0, 0, 1};
+        size_t count = 0;
+        while (true) {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                ++p;
+            }
+            if (p == end || *p == '\n') {
+                break;
+            }
+            if (count == 3 || *p < '0' || *p > '9') {
+                return line;
+            }
+            size_t n = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                n = n * 10 + (*p++ - '0');
+                if (n > (NodeID)-1) {
+                    return line;
+                }
+            }
+            values[count++] = n;
+        }
+        if (count < (arc ? 3u : 2u)) {
+            return line;
+        }
+        EdgeEntry edge = {(NodeID)values[0], (NodeID)values[1],
+            (EdgeWeight)values[2]};
+        edges.push_back(edge);
+        if (p < end) {
+            ++p;
+        }
+    }
+    return NULL;
 }
 
 // Add new node. If maximum node is created already
 // then it won't create
-// NOTE: The maximun edges constraint yet to be added
 bool Graph::add_node(NodeID node_id)
 {
-    if(__mNodes.size() < __mMaxNodes){
-        Node* node = new Node(node_id);
-        __mNodes.insert(std::pair<NodeID, Node*>(node_id, node));
+    if(__mNodeSlab.available()){
+        // Node is not added again
+        if (__mNodeIndex.find(node_id) == HashIndex::NONE) {
+            __new_node(node_id);
+        }
         return true;
     }
     else{
@@ -274,8 +790,12 @@ bool Graph::add_node(NodeID node_id)
 // Remove edge b/w given src and dest
 void Graph::delete_edge(Node& src_node, Node& dest_node)
 {
-    src_node.remove_edge_with_node(dest_node, OUT);
-    dest_node.remove_edge_with_node(src_node, IN);
+    Edge* edge = get_edge(src_node, dest_node);
+    if (edge) {
+        src_node.remove_outgoing_edge(edge);
+        dest_node.remove_incoming_edge(edge);
+        __free_edge(edge);
+    }
 }
 
 // Remove edge (id version)
@@ -306,16 +826,30 @@ void Graph::delete_edge(Edge& edge)
 // the given node links with other node
 void Graph::delete_node(Node& node)
 {
-    NodeIDList adj_list = node.get_adjency_list();
-    for (int i = 0; i < adj_list.size(); ++i) {
-        NodeListIter nIter = __mNodes.find(adj_list[i]);
-        if (nIter != __mNodes.end()) {
-            (nIter->second)->remove_edge_with_node(node, ALL);
+    // Unlink the edges from the other nodes and free them.
+    // A self loop is in both lists, it is freed with out edges
+    const EdgeList& in_list = node.get_in_edge_list();
+    for (size_t i = 0; i < in_list.size(); ++i) {
+        Node* src = in_list[i]->get_source_node();
+        if (src != &node) {
+            src->remove_outgoing_edge(in_list[i]);
+            __free_edge(in_list[i]);
+        }
+    }
+    const EdgeList& out_list = node.get_out_edge_list();
+    for (size_t i = 0; i < out_list.size(); ++i) {
+        Node* dest = out_list[i]->get_destination_node();
+        if (dest != &node) {
+            dest->remove_incoming_edge(out_list[i]);
         }
+        __free_edge(out_list[i]);
     }
     node.unlink_all_edges();
-    // Remove from the Nodes list
-    __mNodes.erase(node.getId());
+    // Remove from the node index
+    __mNodeIndex.erase(node.getId());
+    __mCounters.clear_node(node.get_index());
+    __mNodeSlab.free(node.get_index());
+    __mChanged = true;
 }
 
 // Delete node (id version)
@@ -333,202 +867,1179 @@ void Graph::delete_node(unsigned int node_id)
 // Reset visited bit for all nodes
 void Graph::reset_traversal()
 {
-    NodeListIter nIter = __mNodes.begin();
-    for(; nIter != __mNodes.end(); ++nIter) {
-        (nIter->second)->set_visited(false);
+    std::vector<std::pair<uint64_t, uint64_t> > nodes;
+    __mNodeIndex.get_entries(nodes);
+    for (size_t k = 0; k < nodes.size(); ++k) {
+        __mNodeSlab.get(nodes[k].second)->set_visited(false);
     }
 }
 
-// Get all paths from src and destination using recursive
-void Graph::__form_path(Node& src, Node& dest, std::vector<Path>& nPathList,
-        Path& nPath)
+// Get all paths b/w src and dest. Runs on the frozen graph
+std::vector<Path> Graph::get_paths(Node& src_node, Node& dest_node,
+        size_t max_paths)
 {
-    src.set_visited(true);
-    nPath.push_back(src.getId());
+    return freeze().get_paths(src_node.getId(), dest_node.getId(), max_paths);
+}
 
-    if (src.getId() == dest.getId()) {
-        nPathList.push_back(nPath);
-    }
-    else {
-        NodeIDList outNodes = src.get_adjency_list(OUT);
-        for (int i = 0; i < outNodes.size(); ++i) {
-            Node* node = get_node_from_id(outNodes[i]);
-            if ( (node) && (!(node->is_visited())) ) {
-                __form_path(*node, dest, nPathList, nPath);
-            }
-        }
-    }
-    src.set_visited(false);
-    nPath.pop_back();
+// Get Path (id version)
+std::vector<Path> Graph::get_paths(NodeID src_id, NodeID dest_id,
+        size_t max_paths)
+{
+    return freeze().get_paths(src_id, dest_id, max_paths);
 }
 
-// Get all paths to filter all nodes that not involved in the paths
-std::vector<Path> Graph::get_paths(Node& src_node, Node& dest_node)
+// Get the nodes that are involved in the data flow b/w src and dest.
+// Runs on the frozen graph
+NodeIDList Graph::get_involved_nodes(NodeID src_id, NodeID dest_id)
 {
-    std::vector<Path> nPathList;
-    Path nPath;
-    this->__form_path(src_node, dest_node, nPathList, nPath);
-    return nPathList;
+    return freeze().get_involved_nodes(src_id, dest_id);
 }
 
-// Get Path (id version)
-std::vector<Path> Graph::get_paths(NodeID src_id, NodeID dest_id)
+// Get adjency list of the node based on filter (IN, OUT, ALL).
+// Runs on the frozen graph
+NodeIDList Graph::get_adjency_list(NodeID node_id, ADJNODETYPE type)
 {
-    Node *dest = NULL;
-    Node *src = get_node_from_id(src_id);
-    if (src) {
-        dest = get_node_from_id(dest_id);
-        if(dest) {
-            return (this->get_paths(*src, *dest));
-        }
-    }
-    return std::vector<Path>();
+    return freeze().get_adjency_list(node_id, type);
 }
 
 // Return node object from node id
 Node* Graph::get_node_from_id(NodeID node_id)
 {
-    NodeListIter nIter = __mNodes.find(node_id);
-    if(nIter != __mNodes.end()) {
-        return (nIter->second);
+    uint64_t slot = __mNodeIndex.find(node_id);
+    if (slot != HashIndex::NONE) {
+        return __mNodeSlab.get(slot);
     }
     else{
         return NULL;
     }
 }
 
-/**********************************************************************
- *               EdgeSimualtionProperty class methods                 *
- **********************************************************************/
-std::ofstream& operator<<(std::ofstream& fOut,
-        const EdgeSimualtionProperty& edge)
-{
-    fOut << Log::center(Log::itos(edge._mNoOfPktsTransferred),20) << Log::_mDelimiter;
-    fOut << Log::center(Log::itos(edge._mTotalPktsTransferred),20) << Log::_mDelimiter;
-    fOut << "\n";
-    return fOut;
-}
-
-size_t EdgeSimualtionProperty::get_no_of_pkts_transferred()
+// Return the upper bound of dense node index of the graph
+size_t Graph::get_node_index_bound()
 {
-    return _mNoOfPktsTransferred;
+    return __mNodeSlab.bound();
 }
 
-void EdgeSimualtionProperty::set_no_of_pkts_transferred(size_t value)
+// Return the upper bound of dense edge index of the graph
+size_t Graph::get_edge_index_bound()
 {
-    _mNoOfPktsTransferred = value;
+    return __mEdgeSlab.bound();
 }
 
-// Increment/Decrement capacity by given count
-void EdgeSimualtionProperty::increment_no_of_pkts_transferred()
+// Counters of the last simulation by node and edge index
+GraphCounters& Graph::get_counters()
 {
-    _mNoOfPktsTransferred += 1;
+    return __mCounters;
 }
 
-void EdgeSimualtionProperty::decrement_no_of_pkts_transferred()
+// print the node statistics of the last simulation
+void Graph::print_statistics(Node& node)
 {
-    if (_mNoOfPktsTransferred > 0){
-        _mNoOfPktsTransferred -= 1;
+    size_t i = node.get_index();
+    if (i < __mCounters.pkts_to_be_sent.size()) {
+        Log::print_node_statistics(node.getId(), __mCounters.total_pkts_recv[i],
+                __mCounters.total_pkts_sent[i], __mCounters.pkts_to_be_sent[i]);
     }
-    else{
-        _mNoOfPktsTransferred = 0;
+    else {
+        Log::print_node_statistics(node.getId(), 0, 0, 0);
     }
 }
 
-size_t EdgeSimualtionProperty::get_total_pkts_transferred()
-{
-    return _mTotalPktsTransferred;
-}
-
-void EdgeSimualtionProperty::set_total_pkts_transferred(size_t value)
-{
-    _mTotalPktsTransferred = value;
-}
-
-// Increment/Decrement capacity by given count
-void EdgeSimualtionProperty::increment_total_pkts_transferred()
+// print the edge statistics of the last simulation
+void Graph::print_statistics(Edge& edge)
 {
-    _mTotalPktsTransferred += 1;
+    size_t i = edge.get_index();
+    size_t pkts = 0;
+    size_t total_pkts = 0;
+    if (i < __mCounters.pkts_transferred.size()) {
+        pkts = __mCounters.pkts_transferred[i];
+        total_pkts = __mCounters.total_pkts_transferred[i];
+    }
+    Log::print_edge_statistics(edge.get_source_node()->getId(),
+            edge.get_destination_node()->getId(), edge.get_weight(),
+            pkts, total_pkts);
 }
 
 /**********************************************************************
- *               NodeSimualtionProperty class methods                 *
+ *                     GraphImage class methods                       *
  **********************************************************************/
-std::ofstream& operator<<(std::ofstream& fOut,
-        const NodeSimualtionProperty& node)
-{
-    fOut << Log::center(Log::itos(node._mTotalNoOfPktRecv),23) << Log::_mDelimiter;
-    fOut << Log::center(Log::itos(node._mTotalNoOfPktSent),19) << Log::_mDelimiter;
-    if(node._mNoOfPktToBeSent == (unsigned int)(-1)){
-        fOut << Log::center("Infinity", 26) << Log::_mDelimiter;
-    }
-    else{
-        fOut << Log::center(Log::itos(node._mNoOfPktToBeSent),26) << Log::_mDelimiter;
+GraphImage::GraphImage()
+    :
+        __mMap(NULL),
+        __mMapSize(0),
+        __mHeader(NULL)
+{ }
+
+GraphImage::~GraphImage()
+{
+    close();
+}
+
+// Offsets of the arrays in the image. Returns the size of image
+size_t GraphImage::__layout(size_t nodes, size_t edges, size_t* offsets)
+{
+    size_t sizes[7] = {
+        nodes * sizeof(NodeID),
+        (nodes + 1) * sizeof(uint64_t),
+        (nodes + 1) * sizeof(uint64_t),
+        edges * sizeof(uint64_t),
+        edges * sizeof(uint32_t),
+        edges * sizeof(uint32_t),
+        edges * sizeof(EdgeWeight)
+    };
+    size_t size = sizeof(GraphImageHeader);
+    for (size_t k = 0; k < 7; ++k) {
+        offsets[k] = size;
+        size += (sizes[k] + 7) & ~(size_t)7;
     }
-    fOut << "\n";
-    return fOut;
+    return size;
 }
 
-size_t NodeSimualtionProperty::get_no_pkts_to_be_sent()
+void GraphImage::__attach(const char* base)
 {
-    return _mNoOfPktToBeSent;
+    size_t offsets[7];
+    __mHeader = (const GraphImageHeader*)base;
+    __layout(__mHeader->node_count, __mHeader->edge_count, offsets);
+    __mNodeIds = (const NodeID*)(base + offsets[0]);
+    __mOutOffsets = (const uint64_t*)(base + offsets[1]);
+    __mInOffsets = (const uint64_t*)(base + offsets[2]);
+    __mInEdges = (const uint64_t*)(base + offsets[3]);
+    __mEdgeSrc = (const uint32_t*)(base + offsets[4]);
+    __mEdgeDest = (const uint32_t*)(base + offsets[5]);
+    __mWeights = (const EdgeWeight*)(base + offsets[6]);
 }
 
-void NodeSimualtionProperty::set_no_pkts_to_be_sent(size_t count)
+// Whether the offsets are in order and every node and edge index in
+// the arrays is in range. Node ids must be ascending (see find_node)
+bool GraphImage::__is_valid() const
 {
-    _mNoOfPktToBeSent = count;
+    size_t nodes = node_count();
+    size_t edges = edge_count();
+    const uint64_t* offsets[2] = {__mOutOffsets, __mInOffsets};
+    for (size_t k = 0; k < 2; ++k) {
+        if (offsets[k][0] || (offsets[k][nodes] != edges)) {
+            return false;
+        }
+        for (size_t i = 0; i < nodes; ++i) {
+            if (offsets[k][i] > offsets[k][i+1]) {
+                return false;
+            }
+        }
+    }
+    for (size_t e = 0; e < edges; ++e) {
+        if ((__mEdgeSrc[e] >= nodes) || (__mEdgeDest[e] >= nodes) ||
+                (__mInEdges[e] >= edges)) {
+            return false;
+        }
+    }
+    for (size_t i = 1; i < nodes; ++i) {
+        if (__mNodeIds[i-1] >= __mNodeIds[i]) {
+            return false;
+        }
+    }
+    return true;
 }
 
-// Increment/Decrement number of pkts to be sent
-// by given count
-void NodeSimualtionProperty::increment_no_pkts_to_be_sent()
+// Build the image of the graph
+void GraphImage::build(Graph& graph)
 {
-    _mNoOfPktToBeSent += 1;
-}
+    close();
 
-void NodeSimualtionProperty::decrement_no_pkts_to_be_sent()
-{
-    if (_mNoOfPktToBeSent > 0){
-        _mNoOfPktToBeSent -= 1;
+    // Nodes in ascending id order. Ids are mostly dense, then a table
+    // of ids is used instead of sorting
+    std::vector<std::pair<uint64_t, uint64_t> > ids;
+    graph.__mNodeIndex.get_entries(ids);
+    uint64_t max_id = 0;
+    for (size_t k = 0; k < ids.size(); ++k) {
+        max_id = std::max(max_id, ids[k].first);
     }
-    else{
-        _mNoOfPktToBeSent = 0;
+    if (ids.size() && (max_id < 8 * ids.size())) {
+        std::vector<uint64_t> table(max_id + 1, HashIndex::NONE);
+        for (size_t k = 0; k < ids.size(); ++k) {
+            table[ids[k].first] = ids[k].second;
+        }
+        size_t k = 0;
+        for (size_t id = 0; id < table.size(); ++id) {
+            if (table[id] != HashIndex::NONE) {
+                ids[k++] = std::make_pair(id, table[id]);
+            }
+        }
+    }
+    else {
+        std::sort(ids.begin(), ids.end());
     }
-}
-
-size_t NodeSimualtionProperty::get_total_pkts_sent()
-{
-    return _mTotalNoOfPktSent;
-}
 
-void NodeSimualtionProperty::set_total_pkts_sent(size_t count)
-{
-    _mTotalNoOfPktSent = count;
-}
+    // Image index of the nodes (by graph index)
+    std::vector<uint32_t> node_pos(graph.get_node_index_bound());
+    size_t edges = 0;
+    __mNodes.reserve(ids.size());
+    for (size_t k = 0; k < ids.size(); ++k) {
+        Node* node = graph.__mNodeSlab.get(ids[k].second);
+        node_pos[ids[k].second] = __mNodes.size();
+        __mNodes.push_back(node);
+        edges += node->get_out_edge_list().size();
+    }
+    std::vector<std::pair<uint64_t, uint64_t> >().swap(ids);
+    size_t nodes = __mNodes.size();
+
+    size_t offsets[7];
+    size_t size = __layout(nodes, edges, offsets);
+    __mData.assign(size / sizeof(uint64_t), 0);
+    char* base = (char*)&__mData[0];
+
+    GraphImageHeader* header = (GraphImageHeader*)base;
+    memcpy(header->magic, GRAPH_IMAGE_MAGIC, GRAPH_IMAGE_MAGIC_SIZE);
+    header->version = GRAPH_IMAGE_VERSION;
+    header->header_size = sizeof(GraphImageHeader);
+    header->node_count = nodes;
+    header->edge_count = edges;
+    header->size = size;
+
+    NodeID* node_ids = (NodeID*)(base + offsets[0]);
+    uint64_t* out_offsets = (uint64_t*)(base + offsets[1]);
+    uint64_t* in_offsets = (uint64_t*)(base + offsets[2]);
+    uint64_t* in_edges = (uint64_t*)(base + offsets[3]);
+    uint32_t* edge_src = (uint32_t*)(base + offsets[4]);
+    uint32_t* edge_dest = (uint32_t*)(base + offsets[5]);
+    EdgeWeight* weights = (EdgeWeight*)(base + offsets[6]);
+
+    // Image index of the edges (by graph index)
+    std::vector<uint64_t> edge_pos(graph.get_edge_index_bound());
+    __mEdges.reserve(edges);
+    for (size_t i = 0; i < nodes; ++i) {
+        node_ids[i] = __mNodes[i]->getId();
+        out_offsets[i] = __mEdges.size();
+        const EdgeList& out_list = __mNodes[i]->get_out_edge_list();
+        for (size_t k = 0; k < out_list.size(); ++k) {
+            size_t e = __mEdges.size();
+            edge_pos[out_list[k]->get_index()] = e;
+            edge_src[e] = i;
+            edge_dest[e] = node_pos[
+                out_list[k]->get_destination_node()->get_index()];
+            weights[e] = out_list[k]->get_weight();
+            __mEdges.push_back(out_list[k]);
+        }
+    }
+    out_offsets[nodes] = edges;
+
+    size_t in = 0;
+    for (size_t i = 0; i < nodes; ++i) {
+        in_offsets[i] = in;
+        const EdgeList& in_list = __mNodes[i]->get_in_edge_list();
+        for (size_t k = 0; k < in_list.size(); ++k) {
+            in_edges[in++] = edge_pos[in_list[k]->get_index()];
+        }
+    }
+    in_offsets[nodes] = in;
 
-// Increment total number of pkts sent so far
-// by given count
-void NodeSimualtionProperty::increment_total_pkts_sent()
-{
-    _mTotalNoOfPktSent += 1;
+    __attach(base);
 }
 
-size_t NodeSimualtionProperty::get_total_pkts_received()
+// Map the image written by save(). The header and the indices in the
+// arrays are checked (one pass over them), so that a corrupted image
+// is not accepted
+bool GraphImage::open(const char* file)
 {
-    return _mTotalNoOfPktRecv;
-}
+    close();
 
-void NodeSimualtionProperty::set_total_pkts_received(size_t count)
-{
-    _mTotalNoOfPktRecv = count;
-}
+    int fd = ::open(file, O_RDONLY);
+    if (fd < 0) {
+        std::cout << "\nError: Failed to open file " << file << "\n";
+        return false;
+    }
+    struct stat st;
+    void* map = MAP_FAILED;
+    if ((fstat(fd, &st) == 0) &&
+            ((size_t)st.st_size >= sizeof(GraphImageHeader))) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cout << "\nError: " << file << " is not a graph image\n";
+        return false;
+    }
 
-// Increment total number of pkts sent so far
-// by given count
-void NodeSimualtionProperty::increment_total_pkts_received()
-{
-    _mTotalNoOfPktRecv += 1;
-}
+    const GraphImageHeader* header = (const GraphImageHeader*)map;
+    size_t size = st.st_size;
+    size_t offsets[7];
+    if (memcmp(header->magic, GRAPH_IMAGE_MAGIC, GRAPH_IMAGE_MAGIC_SIZE)) {
+        std::cout << "\nError: " << file << " is not a graph image\n";
+    }
+    else if (header->version != GRAPH_IMAGE_VERSION) {
+        std::cout << "\nError: Unsupported graph image version ";
+        std::cout << header->version << "\n";
+    }
+    else if ((header->header_size != sizeof(GraphImageHeader)) ||
+            (header->size != size) || (header->node_count > size) ||
+            (header->edge_count > size) ||
+            (__layout(header->node_count, header->edge_count,
+                      offsets) != size)) {
+        std::cout << "\nError: Graph image " << file << " is corrupted\n";
+    }
+    else {
+        __mMap = map;
+        __mMapSize = size;
+        __attach((const char*)map);
+        if (__is_valid()) {
+            return true;
+        }
+        std::cout << "\nError: Graph image " << file << " is corrupted\n";
+        close();
+        return false;
+    }
+    munmap(map, size);
+    return false;
+}
+
+// Write the image to the file. It is written to a temporary file
+// first, so the file can be the one mapped
+bool GraphImage::save(const char* file)
+{
+    std::string temp(file);
+    temp.append(".tmp");
+    std::ofstream out(temp.c_str(), std::ofstream::binary);
+    if (out.fail()) {
+        std::cout << "\nError: Failed to create file " << file << "\n";
+        return false;
+    }
+    out.write((const char*)__mHeader, __mHeader->size);
+    out.close();
+    if (out.fail() || std::rename(temp.c_str(), file)) {
+        std::cout << "\nError: Failed to write file " << file << "\n";
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void GraphImage::close()
+{
+    if (__mMap) {
+        munmap(__mMap, __mMapSize);
+        __mMap = NULL;
+        __mMapSize = 0;
+    }
+    std::vector<uint64_t>().swap(__mData);
+    std::vector<Node*>().swap(__mNodes);
+    std::vector<Edge*>().swap(__mEdges);
+    __mHeader = NULL;
+}
+
+Node* GraphImage::get_node(size_t i)
+{
+    return (i < __mNodes.size()) ? __mNodes[i] : NULL;
+}
+
+Edge* GraphImage::get_edge(size_t e)
+{
+    return (e < __mEdges.size()) ? __mEdges[e] : NULL;
+}
+
+size_t GraphImage::find_node(NodeID node_id) const
+{
+    const NodeID* end = __mNodeIds + node_count();
+    const NodeID* id = std::lower_bound(__mNodeIds, end, node_id);
+    if ((id != end) && (*id == node_id)) {
+        return id - __mNodeIds;
+    }
+    return node_count();
+}
+
+std::vector<Path> GraphImage::get_paths(NodeID src_id, NodeID dest_id,
+        size_t max_paths)
+{
+    std::vector<Path> nPathList;
+    PathIterator paths(*this, src_id, dest_id);
+    Path path;
+    while ((!max_paths || nPathList.size() < max_paths) && paths.next(path)) {
+        nPathList.push_back(path);
+    }
+    return nPathList;
+}
+
+// Mark all nodes reachable from the given node (breadth first).
+// Follows the out edges for OUT and the in edges for IN. The edges
+// of stop node are not followed
+void GraphImage::__mark_reachable(size_t start, ADJNODETYPE type,
+        std::vector<bool>& marked, size_t stop)
+{
+    std::vector<size_t> queue;
+    queue.push_back(start);
+    marked[start] = true;
+
+    for (size_t q = 0; q < queue.size(); ++q) {
+        size_t i = queue[q];
+        if (i == stop) {
+            continue;
+        }
+        if (type == IN) {
+            for (size_t k = in_begin(i); k < in_end(i); ++k) {
+                size_t node = edge_src(in_edge(k));
+                if (!marked[node]) {
+                    marked[node] = true;
+                    queue.push_back(node);
+                }
+            }
+        }
+        else {
+            for (size_t e = out_begin(i); e < out_end(i); ++e) {
+                size_t node = edge_dest(e);
+                if (!marked[node]) {
+                    marked[node] = true;
+                    queue.push_back(node);
+                }
+            }
+        }
+    }
+}
+
+// Get the nodes that are involved in the data flow b/w src and dest,
+// i.e. reachable from src and can reach dest. Linear in graph size.
+// Destination does not forward and source does not consume the data,
+// so the search does not pass through them
+NodeIDList GraphImage::get_involved_nodes(NodeID src_id, NodeID dest_id)
+{
+    NodeIDList involved;
+    size_t src = find_node(src_id);
+    size_t dest = find_node(dest_id);
+    if ((src == node_count()) || (dest == node_count())) {
+        return involved;
+    }
+
+    std::vector<bool> forward(node_count(), false);
+    std::vector<bool> backward(node_count(), false);
+    __mark_reachable(src, OUT, forward, dest);
+    __mark_reachable(dest, IN, backward, src);
+
+    for (size_t i = 0; i < node_count(); ++i) {
+        if (forward[i] && backward[i]) {
+            involved.push_back(node_id(i));
+        }
+    }
+    return involved;
+}
+
+// Get adjency list of the node based on filter (IN, OUT, ALL), in
+// order of in and out edge lists
+NodeIDList GraphImage::get_adjency_list(NodeID node_id, ADJNODETYPE type)
+{
+    NodeIDList adj_list;
+    size_t i = find_node(node_id);
+    if (i == node_count()) {
+        return adj_list;
+    }
+    if (type == IN || type == ALL) {
+        for (size_t k = in_begin(i); k < in_end(i); ++k) {
+            adj_list.push_back(this->node_id(edge_src(in_edge(k))));
+        }
+    }
+    if (type == OUT || type == ALL) {
+        for (size_t e = out_begin(i); e < out_end(i); ++e) {
+            adj_list.push_back(this->node_id(edge_dest(e)));
+        }
+    }
+    return adj_list;
+}
+
+// Level of the nodes reachable from src in the residual graph (breadth
+// first). Returns true if dest is reachable
+bool GraphImage::__level_graph(size_t src, size_t dest,
+        const std::vector<size_t>& flow, std::vector<size_t>& level)
+{
+    std::fill(level.begin(), level.end(), (size_t)-1);
+    std::vector<size_t> queue;
+    queue.push_back(src);
+    level[src] = 0;
+
+    for (size_t q = 0; q < queue.size(); ++q) {
+        size_t i = queue[q];
+        for (size_t e = out_begin(i); e < out_end(i); ++e) {
+            size_t node = edge_dest(e);
+            if ((level[node] == (size_t)-1) && (flow[e] < weight(e))) {
+                level[node] = level[i] + 1;
+                queue.push_back(node);
+            }
+        }
+        for (size_t k = in_begin(i); k < in_end(i); ++k) {
+            size_t e = in_edge(k);
+            size_t node = edge_src(e);
+            if ((level[node] == (size_t)-1) && flow[e]) {
+                level[node] = level[i] + 1;
+                queue.push_back(node);
+            }
+        }
+    }
+    return (level[dest] != (size_t)-1);
+}
+
+// Saturate the shortest paths of the level graph. The path is walked
+// with a stack of arcs, next is the first arc of a node not tried yet
+size_t GraphImage::__blocking_flow(size_t src, size_t dest,
+        std::vector<size_t>& flow, std::vector<size_t>& level,
+        std::vector<size_t>& next)
+{
+    size_t total = 0;
+    std::vector<size_t> path;
+    size_t node = src;
+    while (true) {
+        if (node == dest) {
+            // Push the bottleneck and go back to the first arc saturated
+            size_t pushed = (size_t)-1;
+            size_t saturated = 0;
+            for (size_t k = 0; k < path.size(); ++k) {
+                size_t e = path[k] >> 1;
+                size_t residual = (path[k] & 1) ? flow[e] : weight(e) - flow[e];
+                if (residual < pushed) {
+                    pushed = residual;
+                    saturated = k;
+                }
+            }
+            for (size_t k = 0; k < path.size(); ++k) {
+                size_t e = path[k] >> 1;
+                if (path[k] & 1) {
+                    flow[e] -= pushed;
+                }
+                else {
+                    flow[e] += pushed;
+                }
+            }
+            total += pushed;
+            node = __arc_tail(path[saturated]);
+            path.resize(saturated);
+            continue;
+        }
+
+        // Out edges, then in edges in reverse
+        size_t out = out_end(node) - out_begin(node);
+        size_t degree = out + in_end(node) - in_begin(node);
+        for (; next[node] < degree; ++next[node]) {
+            size_t arc = (next[node] < out) ? (out_begin(node) + next[node]) * 2
+                : in_edge(in_begin(node) + next[node] - out) * 2 + 1;
+            size_t e = arc >> 1;
+            size_t residual = (arc & 1) ? flow[e] : weight(e) - flow[e];
+            if (residual && (level[__arc_head(arc)] == level[node] + 1)) {
+                break;
+            }
+        }
+        if (next[node] < degree) {
+            size_t arc = (next[node] < out) ? (out_begin(node) + next[node]) * 2
+                : in_edge(in_begin(node) + next[node] - out) * 2 + 1;
+            path.push_back(arc);
+            node = __arc_head(arc);
+            continue;
+        }
+
+        // No path to dest through the node
+        level[node] = (size_t)-1;
+        if (path.empty()) {
+            break;
+        }
+        node = __arc_tail(path.back());
+        path.pop_back();
+        ++next[node];
+    }
+    return total;
+}
+
+size_t GraphImage::max_flow(NodeID src_id, NodeID dest_id,
+        std::vector<size_t>* cut)
+{
+    size_t src = find_node(src_id);
+    size_t dest = find_node(dest_id);
+    if ((src == node_count()) || (dest == node_count()) || (src == dest)) {
+        return 0;
+    }
+
+    size_t total = 0;
+    std::vector<size_t> flow(edge_count(), 0);
+    std::vector<size_t> level(node_count());
+    std::vector<size_t> next(node_count());
+    while (__level_graph(src, dest, flow, level)) {
+        std::fill(next.begin(), next.end(), 0);
+        total += __blocking_flow(src, dest, flow, level, next);
+    }
+
+    // The nodes still reachable from src are the source side of the cut
+    if (cut) {
+        for (size_t e = 0; e < edge_count(); ++e) {
+            if ((level[edge_src(e)] != (size_t)-1) &&
+                    (level[edge_dest(e)] == (size_t)-1)) {
+                cut->push_back(e);
+            }
+        }
+    }
+    return total;
+}
+
+// Count the paths of the involved nodes in reverse topological order,
+// which is the order Tarjan's algorithm finds the strongly connected
+// components in. The paths of a node are the sum of the paths of its
+// out nodes. Edges out of dest and into src are not part of any simple
+// path, so they are left out
+bool GraphImage::count_paths(NodeID src_id, NodeID dest_id, PathCount& count,
+        std::vector<NodeIDList>* cycles)
+{
+    const size_t NONE = (size_t)-1;
+    count = PathCount();
+    size_t src = find_node(src_id);
+    size_t dest = find_node(dest_id);
+    if ((src == node_count()) || (dest == node_count())) {
+        return true;
+    }
+    std::vector<bool> involved(node_count(), false);
+    std::vector<bool> backward(node_count(), false);
+    __mark_reachable(src, OUT, involved, dest);
+    __mark_reachable(dest, IN, backward, src);
+    for (size_t i = 0; i < node_count(); ++i) {
+        involved[i] = involved[i] && backward[i];
+    }
+    if (!involved[src]) {
+        return true;
+    }
+
+    std::vector<size_t> order(node_count(), NONE);
+    std::vector<size_t> low(node_count(), 0);
+    std::vector<bool> on_stack(node_count(), false);
+    std::vector<bool> looped(node_count(), false);
+    std::vector<PathCount> paths(node_count());
+    std::vector<size_t> stack;              // Nodes of open components
+    std::vector<size_t> nodes;              // Depth first search path
+    std::vector<size_t> next;               // Next out edge of each of them
+    size_t visited = 0;
+    bool acyclic = true;
+
+    order[src] = low[src] = visited++;
+    stack.push_back(src);
+    on_stack[src] = true;
+    nodes.push_back(src);
+    next.push_back(out_begin(src));
+    while (nodes.size()) {
+        size_t node = nodes.back();
+        if ((node != dest) && (next.back() < out_end(node))) {
+            size_t to = edge_dest(next.back()++);
+            if (!involved[to] || (to == src)) {
+                continue;
+            }
+            if (to == node) {
+                looped[node] = true;
+            }
+            else if (order[to] == NONE) {
+                order[to] = low[to] = visited++;
+                stack.push_back(to);
+                on_stack[to] = true;
+                nodes.push_back(to);
+                next.push_back(out_begin(to));
+            }
+            else if (on_stack[to]) {
+                low[node] = std::min(low[node], order[to]);
+            }
+            continue;
+        }
+        nodes.pop_back();
+        next.pop_back();
+        if (nodes.size()) {
+            low[nodes.back()] = std::min(low[nodes.back()], low[node]);
+        }
+        if (low[node] != order[node]) {
+            continue;
+        }
+
+        // Component of node is complete
+        NodeIDList component;
+        size_t i;
+        do {
+            i = stack.back();
+            stack.pop_back();
+            on_stack[i] = false;
+            component.push_back(node_id(i));
+        } while (i != node);
+        if ((component.size() > 1) || looped[node]) {
+            acyclic = false;
+            if (cycles) {
+                std::sort(component.begin(), component.end());
+                cycles->push_back(component);
+            }
+        }
+        else if (acyclic && (node == dest)) {
+            paths[node] = PathCount(1);
+        }
+        else if (acyclic) {
+            for (size_t e = out_begin(node); e < out_end(node); ++e) {
+                size_t to = edge_dest(e);
+                if (involved[to] && (to != src)) {
+                    paths[node] += paths[to];
+                }
+            }
+        }
+    }
+    if (acyclic) {
+        count = paths[src];
+    }
+    return acyclic;
+}
+
+/**********************************************************************
+ *                     PathCount class methods                        *
+ **********************************************************************/
+PathCount::PathCount(uint64_t n)
+{
+    for (; n; n >>= 32) {
+        __mDigits.push_back((uint32_t)n);
+    }
+}
+
+PathCount& PathCount::operator+=(const PathCount& other)
+{
+    if (__mDigits.size() < other.__mDigits.size()) {
+        __mDigits.resize(other.__mDigits.size(), 0);
+    }
+    uint64_t carry = 0;
+    for (size_t k = 0; k < __mDigits.size(); ++k) {
+        if ((k >= other.__mDigits.size()) && !carry) {
+            break;
+        }
+        carry += __mDigits[k];
+        if (k < other.__mDigits.size()) {
+            carry += other.__mDigits[k];
+        }
+        __mDigits[k] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry) {
+        __mDigits.push_back((uint32_t)carry);
+    }
+    return *this;
+}
+
+// Decimal digits, by dividing by 10^9 till zero
+std::string PathCount::to_string() const
+{
+    if (is_zero()) {
+        return "0";
+    }
+    std::vector<uint32_t> digits(__mDigits);
+    std::vector<uint32_t> parts;            // Base 10^9, lowest first
+    while (digits.size()) {
+        uint64_t rem = 0;
+        for (size_t k = digits.size(); k > 0; --k) {
+            uint64_t value = (rem << 32) | digits[k-1];
+            digits[k-1] = (uint32_t)(value / 1000000000);
+            rem = value % 1000000000;
+        }
+        parts.push_back((uint32_t)rem);
+        while (digits.size() && !digits.back()) {
+            digits.pop_back();
+        }
+    }
+    std::ostringstream out;
+    out << parts.back();
+    for (size_t k = parts.size() - 1; k > 0; --k) {
+        out << std::setw(9) << std::setfill('0') << parts[k-1];
+    }
+    return out.str();
+}
+
+/**********************************************************************
+ *                     PathIterator class methods                     *
+ **********************************************************************/
+PathIterator::PathIterator(GraphImage& image, NodeID src_id, NodeID dest_id,
+        PATHORDER order)
+    :
+        __mImage(image),
+        __mOrder(order),
+        __mSrc(image.find_node(src_id)),
+        __mDest(image.find_node(dest_id)),
+        __mStarted(false),
+        __mTimedOut(false),
+        __mTimeLimit(0)
+{
+    if ((__mSrc == image.node_count()) || (__mDest == image.node_count())) {
+        __mSrc = __mDest = image.node_count();
+    }
+}
+
+void PathIterator::set_time_limit(size_t ms)
+{
+    __mTimeLimit = ms;
+    __mDeadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(ms);
+}
+
+bool PathIterator::next(Path& path)
+{
+    if ((__mSrc == __mImage.node_count()) || __mTimedOut) {
+        return false;
+    }
+    if (__mOrder == PATHS_DFS) {
+        return __next_dfs(path);
+    }
+    return __next_shortest(path);
+}
+
+bool PathIterator::__is_time_over()
+{
+    if (__mTimeLimit && (std::chrono::steady_clock::now() >= __mDeadline)) {
+        __mTimedOut = true;
+    }
+    return __mTimedOut;
+}
+
+// Continue the depth first search till the next path. Only the nodes
+// that can reach the destination are visited. The search keeps its
+// own stack, so that long paths don't overflow the call stack
+bool PathIterator::__next_dfs(Path& path)
+{
+    GraphImage& image = __mImage;
+    if (!__mStarted) {
+        __mStarted = true;
+        __mInvolved.assign(image.node_count(), false);
+        image.__mark_reachable(__mDest, IN, __mInvolved, __mSrc);
+        if (!__mInvolved[__mSrc]) {
+            return false;
+        }
+        __mVisited.assign(image.node_count(), false);
+        __mVisited[__mSrc] = true;
+        __mNodes.push_back(__mSrc);
+        __mNext.push_back(image.out_begin(__mSrc));
+        if (__mSrc == __mDest) {
+            path.assign(1, image.node_id(__mSrc));
+            return true;
+        }
+    }
+
+    for (size_t steps = 1; __mNodes.size(); ++steps) {
+        if (!(steps & 0xfff) && __is_time_over()) {
+            return false;
+        }
+        size_t node = __mNodes.back();
+        if ((node == __mDest) || (__mNext.back() == image.out_end(node))) {
+            __mVisited[node] = false;
+            __mNodes.pop_back();
+            __mNext.pop_back();
+            continue;
+        }
+        size_t to = image.edge_dest(__mNext.back()++);
+        if (__mInvolved[to] && !__mVisited[to]) {
+            __mVisited[to] = true;
+            __mNodes.push_back(to);
+            __mNext.push_back(image.out_begin(to));
+            if (to == __mDest) {
+                path.clear();
+                for (size_t k = 0; k < __mNodes.size(); ++k) {
+                    path.push_back(image.node_id(__mNodes[k]));
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Next shortest path (Yen). The candidates are the last path found
+// with its tail replaced by the shortest path from each of its nodes
+// (spur node), that leaves the spur node by an edge not taken by any
+// path found with the same nodes before it
+bool PathIterator::__next_shortest(Path& path)
+{
+    GraphImage& image = __mImage;
+    if (!__mStarted) {
+        __mStarted = true;
+        __mAdded = 0;
+        __mBlockedNodes.assign(image.node_count(), false);
+        __mBlockedEdges.assign(image.edge_count(), false);
+        __mDist.assign(image.node_count(), (size_t)-1);
+        __mVia.assign(image.node_count(), 0);
+        __mPos.assign(image.node_count(), (size_t)-1);
+        __set_dest_distances();
+        PathCandidate candidate;
+        if (!__shortest_path(__mSrc, 0, candidate.detour, candidate.rejoin)) {
+            return false;
+        }
+        __mFound.push_back(candidate.detour);
+        __mFoundCost.push_back(__mToDest[__mSrc]);
+    }
+    else if (__mFound.size()) {
+        __add_candidates();
+        if (__mTimedOut) {
+            return false;
+        }
+        bool found = false;
+        while (!found && __mCandidates.size()) {
+            size_t cost = __mCandidates.begin()->first.first;
+            PathCandidate& candidate = __mCandidates.begin()->second;
+            const std::vector<size_t>& from = __mFound[candidate.path];
+            std::vector<size_t> edges(from.begin(),
+                    from.begin() + candidate.spur);
+            edges.insert(edges.end(), candidate.detour.begin(),
+                    candidate.detour.end());
+            if (candidate.rejoin != (size_t)-1) {
+                edges.insert(edges.end(), from.begin() + candidate.rejoin,
+                        from.end());
+            }
+            __mCandidates.erase(__mCandidates.begin());
+            // Same path may be a candidate from two paths found
+            found = true;
+            for (size_t p = 0; found && (p < __mFound.size()); ++p) {
+                found = (__mFoundCost[p] != cost) || (__mFound[p] != edges);
+            }
+            if (found) {
+                __mFound.push_back(edges);
+                __mFoundCost.push_back(cost);
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    else {
+        return false;
+    }
+
+    const std::vector<size_t>& edges = __mFound.back();
+    path.assign(1, image.node_id(__mSrc));
+    for (size_t k = 0; k < edges.size(); ++k) {
+        path.push_back(image.node_id(image.edge_dest(edges[k])));
+    }
+    return true;
+}
+
+// Add the candidates of the spur nodes of the last path found. The
+// shortest path from a spur node may end by the rest of the last path,
+// so it is kept as the detour only
+void PathIterator::__add_candidates()
+{
+    GraphImage& image = __mImage;
+    const size_t last_index = __mFound.size() - 1;
+    const std::vector<size_t>& last = __mFound[last_index];
+    const size_t count = last.size();
+
+    // Position of each node of the last path and the cost from there
+    __mRestCost.assign(count + 1, 0);
+    __mPos[__mSrc] = 0;
+    for (size_t k = count; k > 0; --k) {
+        __mRestCost[k-1] = __mRestCost[k] + __cost(last[k-1]);
+        __mPos[image.edge_dest(last[k-1])] = k;
+    }
+    // No of first edges each path found shares with the last path
+    std::vector<size_t> shared(last_index);
+    for (size_t p = 0; p < last_index; ++p) {
+        const std::vector<size_t>& found = __mFound[p];
+        size_t k = 0;
+        while ((k < count) && (k < found.size()) && (found[k] == last[k])) {
+            ++k;
+        }
+        shared[p] = k;
+    }
+
+    size_t root_cost = 0;
+    size_t i = 0;
+    for (; i < count; ++i) {
+        if (__is_time_over()) {
+            break;
+        }
+        size_t spur = i ? image.edge_dest(last[i-1]) : __mSrc;
+        __mBlockedEdges[last[i]] = true;
+        for (size_t p = 0; p < last_index; ++p) {
+            if ((shared[p] >= i) && (__mFound[p].size() > i)) {
+                __mBlockedEdges[__mFound[p][i]] = true;
+            }
+        }
+
+        PathCandidate candidate;
+        if (__shortest_path(spur, i, candidate.detour, candidate.rejoin)) {
+            size_t cost = root_cost;
+            for (size_t k = 0; k < candidate.detour.size(); ++k) {
+                cost += __cost(candidate.detour[k]);
+            }
+            if (candidate.rejoin != (size_t)-1) {
+                cost += __mRestCost[candidate.rejoin];
+            }
+            candidate.path = last_index;
+            candidate.spur = i;
+            __mCandidates.insert(std::make_pair(
+                        std::make_pair(cost, __mAdded++), candidate));
+        }
+
+        __mBlockedEdges[last[i]] = false;
+        for (size_t p = 0; p < last_index; ++p) {
+            if (__mFound[p].size() > i) {
+                __mBlockedEdges[__mFound[p][i]] = false;
+            }
+        }
+        // Nodes before the next spur node are not passed again
+        __mBlockedNodes[spur] = true;
+        root_cost += __cost(last[i]);
+    }
+
+    __mBlockedNodes[__mSrc] = false;
+    __mPos[__mSrc] = (size_t)-1;
+    for (size_t k = 0; k < count; ++k) {
+        __mBlockedNodes[image.edge_dest(last[k])] = false;
+        __mPos[image.edge_dest(last[k])] = (size_t)-1;
+    }
+}
+
+size_t PathIterator::__cost(size_t edge) const
+{
+    return (__mOrder == PATHS_WEIGHT) ? __mImage.weight(edge) : 1;
+}
+
+// Distance of each node to dest with no node or edge blocked (Dijkstra
+// over the in edges). Blocking only makes the distances longer, so they
+// guide the search for the shortest paths (A*)
+void PathIterator::__set_dest_distances()
+{
+    GraphImage& image = __mImage;
+    typedef std::pair<size_t, size_t> Entry;    // Distance and node
+    std::priority_queue<Entry, std::vector<Entry>,
+        std::greater<Entry> > queue;
+
+    __mToDest.assign(image.node_count(), (size_t)-1);
+    __mToDest[__mDest] = 0;
+    queue.push(Entry(0, __mDest));
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+        size_t node = entry.second;
+        if (entry.first > __mToDest[node]) {
+            continue;
+        }
+        for (size_t k = image.in_begin(node); k < image.in_end(node); ++k) {
+            size_t e = image.in_edge(k);
+            size_t from = image.edge_src(e);
+            size_t dist = entry.first + __cost(e);
+            if (dist < __mToDest[from]) {
+                __mToDest[from] = dist;
+                queue.push(Entry(dist, from));
+            }
+        }
+    }
+}
+
+// Shortest path from src (at position spur of the last path found) to
+// dest that does not pass the blocked nodes and edges (A* with the
+// distances to dest). The search ends at a node after spur of the last
+// path if the rest of it is a shortest path to dest, then rejoin is
+// its position (else NONE). The edges till there are set to edges
+bool PathIterator::__shortest_path(size_t src, size_t spur,
+        std::vector<size_t>& edges, size_t& rejoin)
+{
+    GraphImage& image = __mImage;
+    const size_t NONE = (size_t)-1;
+    // Estimate, distance not gone and node. Of the equal estimates the
+    // nearest to dest is taken first, that avoids searching all ties
+    typedef std::tuple<size_t, size_t, size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>,
+        std::greater<Entry> > queue;
+
+    edges.clear();
+    rejoin = NONE;
+    if (__mToDest[src] == NONE) {
+        return false;
+    }
+    size_t end = NONE;
+    __mDist[src] = 0;
+    __mTouched.push_back(src);
+    queue.push(Entry(__mToDest[src], __mToDest[src], src));
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+        size_t node = std::get<2>(entry);
+        if (std::get<0>(entry) > __mDist[node] + __mToDest[node]) {
+            continue;
+        }
+        if (node == __mDest) {
+            end = node;
+            break;
+        }
+        // The estimate is the least, so nothing is shorter than going
+        // on by the rest of the last path
+        size_t pos = __mPos[node];
+        if ((pos != NONE) && (pos > spur) &&
+                (__mRestCost[pos] == __mToDest[node]) &&
+                __is_rejoin(node, src)) {
+            end = node;
+            rejoin = pos;
+            break;
+        }
+        for (size_t e = image.out_begin(node); e < image.out_end(node); ++e) {
+            size_t to = image.edge_dest(e);
+            if (__mBlockedNodes[to] || __mBlockedEdges[e] ||
+                    (__mToDest[to] == NONE)) {
+                continue;
+            }
+            size_t dist = __mDist[node] + __cost(e);
+            if (dist < __mDist[to]) {
+                if (__mDist[to] == NONE) {
+                    __mTouched.push_back(to);
+                }
+                __mDist[to] = dist;
+                __mVia[to] = e;
+                queue.push(Entry(dist + __mToDest[to], __mToDest[to], to));
+            }
+        }
+    }
+
+    if (end != NONE) {
+        for (size_t node = end; node != src;
+                node = image.edge_src(__mVia[node])) {
+            edges.push_back(__mVia[node]);
+        }
+        std::reverse(edges.begin(), edges.end());
+    }
+    for (size_t k = 0; k < __mTouched.size(); ++k) {
+        __mDist[__mTouched[k]] = NONE;
+    }
+    __mTouched.clear();
+    return (end != NONE);
+}
+
+// Whether the path searched from src to node can go on by the rest of
+// the last path from node, that is it has no node of the rest
+bool PathIterator::__is_rejoin(size_t node, size_t src)
+{
+    GraphImage& image = __mImage;
+    size_t pos = __mPos[node];
+    while (node != src) {
+        node = image.edge_src(__mVia[node]);
+        if ((__mPos[node] != (size_t)-1) && (__mPos[node] >= pos)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**********************************************************************
+ *                     GraphCounters methods                          *
+ **********************************************************************/
+// Zero the counters of nodes and edges below the index bounds
+void GraphCounters::reset(size_t nodes, size_t edges)
+{
+    pkts_transferred.assign(edges, 0);
+    total_pkts_transferred.assign(edges, 0);
+    pkts_to_be_sent.assign(nodes, 0);
+    total_pkts_recv.assign(nodes, 0);
+    total_pkts_sent.assign(nodes, 0);
+}
+
+// Zero the counters of a deleted node, its index is reused
+void GraphCounters::clear_node(size_t index)
+{
+    if (index < pkts_to_be_sent.size()) {
+        pkts_to_be_sent[index] = 0;
+        total_pkts_recv[index] = 0;
+        total_pkts_sent[index] = 0;
+    }
+}
+
+// Zero the counters of a deleted edge, its index is reused
+void GraphCounters::clear_edge(size_t index)
+{
+    if (index < pkts_transferred.size()) {
+        pkts_transferred[index] = 0;
+        total_pkts_transferred[index] = 0;
+    }
+}
 
 /**********************************************************************
  *                     Log class methods                              *
@@ -537,428 +2048,1858 @@ void NodeSimualtionProperty::increment_total_pkts_received()
 std::ofstream Log::_mCout;
 size_t Log::_mTotalWidth = 82;
 char Log::_mDelimiter = '|';
+thread_local std::string Log::__mBuffer;
+std::deque<std::string> Log::__mQueue;
+std::vector<std::string> Log::__mFree;
+std::mutex Log::__mMutex;
+std::condition_variable Log::__mQueued;
+std::condition_variable Log::__mWritten;
+std::thread Log::__mWriter;
+bool Log::__mStop = false;
+uint64_t Log::__mWriteTime = 0;
+
+bool Log::open(std::string& file)
+{
+    if(file.size()){
+        _mCout.open(file.c_str(), std::ofstream::out);
+        if(!_mCout.fail()){
+            __mBuffer.clear();
+            __mFree.resize(LOG_BUFFERS);
+            __mStop = false;
+            __mWriter = std::thread(&Log::__write_buffers);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Write all pending logs and close the file
+void Log::close()
+{
+    flush();
+    if (__mWriter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(__mMutex);
+            __mStop = true;
+        }
+        __mQueued.notify_one();
+        __mWriter.join();
+    }
+    _mCout.close();
+}
+
+void Log::flush()
+{
+    if (__mBuffer.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(__mMutex);
+    // Log is not opened
+    if (!__mWriter.joinable()) {
+        __mBuffer.clear();
+        return;
+    }
+    // Wait for the writer if all buffers are queued
+    while (__mFree.empty()) {
+        __mWritten.wait(lock);
+    }
+    // Swap the full buffer with a written one to reuse its memory
+    __mQueue.push_back(std::string());
+    __mQueue.back().swap(__mFree.back());
+    __mFree.pop_back();
+    __mQueue.back().swap(__mBuffer);
+    __mQueued.notify_one();
+}
+
+uint64_t Log::get_write_time()
+{
+    std::lock_guard<std::mutex> lock(__mMutex);
+    return __mWriteTime;
+}
+
+// Writer thread. Writes the queued buffers in order until stopped
+void Log::__write_buffers()
+{
+    std::string buffer;
+    std::unique_lock<std::mutex> lock(__mMutex);
+    while (true) {
+        while (__mQueue.empty() && !__mStop) {
+            __mQueued.wait(lock);
+        }
+        if (__mQueue.empty()) {
+            break;
+        }
+        buffer.swap(__mQueue.front());
+        __mQueue.pop_front();
+        lock.unlock();
+
+        STATS_TIMER(written);
+        _mCout.write(buffer.data(), buffer.size());
+        buffer.clear();
+
+        lock.lock();
+        STATS_ELAPSED(__mWriteTime, written);
+        __mFree.push_back(std::string());
+        __mFree.back().swap(buffer);
+        __mWritten.notify_all();
+    }
+}
+
+std::string Log::ftos(float n)
+{
+    // Same as default format of ostream
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%g", n);
+    return std::string(buf, len);
+}
+
+std::string Log::itos(size_t n)
+{
+    char buf[24];
+    return std::string(buf, __put_uint(buf, n) - buf);
+}
+
+void Log::print(const std::string& str)
+{
+    __append(str.data(), str.size());
+}
+
+void Log::__append(const char* str, size_t len)
+{
+    __mBuffer.append(str, len);
+    if (__mBuffer.size() >= LOG_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+// Print the given string in the center of given width
+// Will be used to print table
+std::string Log::center(const std::string str, int width)
+{
+    std::string out(std::max((size_t)width, str.size()), ' ');
+    out.resize(__put_center(&out[0], str.data(), str.size(), width)
+            - out.data());
+    return out;
+}
+
+// Put the number at p and return the end
+char* Log::__put_uint(char* p, size_t n)
+{
+    return std::to_chars(p, p + 20, n).ptr;
+}
+
+// Put the string at p in the center of given width and return the end.
+// The extra space of odd padding goes to the right
+char* Log::__put_center(char* p, const char* str, size_t len, size_t width)
+{
+    size_t padding = (width > len) ? (width - len) : 0;
+    std::memset(p, ' ', padding / 2);
+    p += padding / 2;
+    std::memcpy(p, str, len);
+    p += len;
+    std::memset(p, ' ', padding - padding / 2);
+    return p + (padding - padding / 2);
+}
+
+// Put the number at p in the center of given width and return the end
+char* Log::__put_center(char* p, size_t n, size_t width)
+{
+    char buf[24];
+    return __put_center(p, buf, __put_uint(buf, n) - buf, width);
+}
+
+char* Log::__put_float_center(char* p, float n, size_t width)
+{
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%g", n);
+    return __put_center(p, buf, len, width);
+}
+
+// Heading of a table with the given columns
+std::string Log::__table_heading(const std::string& title,
+        const char** columns, const size_t* widths, size_t count)
+{
+    std::string fill(_mTotalWidth, '-');
+    std::string space((_mTotalWidth-30)/2, ' ');
+    std::string heading("\n");
+    heading.append(space).append(title).append(space);
+    heading.append("\n").append(fill).append("\n");
+    for (size_t i = 0; i < count; ++i) {
+        heading.append(center(columns[i], widths[i])).append("|");
+    }
+    heading.append("\n").append(fill).append("\n");
+    return heading;
+}
+
+// Print the heading of the table
+// It will be printed for every cycle
+void Log::print_node_statistics_heading()
+{
+    static const char* columns[] = {"NODE #", "TOTAL PKTs RECEIVED",
+        "TOTAL PKTs SENT", "TOTAL PKTs REMAINING"};
+    static const size_t widths[] = {10, 23, 19, 26};
+    static const std::string heading = __table_heading("NODE STATISTICS ",
+            columns, widths, 4);
+    print(heading);
+}
+
+void Log::print_edge_statistics_heading()
+{
+    static const char* columns[] = {"Edge", "WEIGHT", "# PKTs TXed",
+        "TOTAL PKTs TXed"};
+    static const size_t widths[] = {20, 18, 20, 20};
+    static const std::string heading = __table_heading("EDGE STATISTICS ",
+            columns, widths, 4);
+    print(heading);
+}
+
+// The rows are formatted in a buffer on stack
+void Log::print_edge_statistics(NodeID src, NodeID dest,
+        EdgeWeight weight, size_t pkts_txed, size_t total_pkts_txed)
+{
+    char edge[32];
+    char* p = __put_uint(edge, src);
+    std::memcpy(p, "--->", 4);
+    p = __put_uint(p + 4, dest);
+
+    char row[128];
+    p = __put_center(row, edge, p - edge, 20);
+    *p++ = _mDelimiter;
+    p = __put_center(p, weight, 18);
+    *p++ = _mDelimiter;
+    p = __put_center(p, pkts_txed, 20);
+    *p++ = _mDelimiter;
+    p = __put_center(p, total_pkts_txed, 20);
+    *p++ = _mDelimiter;
+    *p++ = '\n';
+    __append(row, p - row);
+}
+
+void Log::print_node_statistics(NodeID id, size_t total_pkts_recv,
+        size_t total_pkts_sent, size_t pkts_remaining)
+{
+    char row[128];
+    char* p = __put_center(row, id, 10);
+    *p++ = _mDelimiter;
+    p = __put_center(p, total_pkts_recv, 23);
+    *p++ = _mDelimiter;
+    p = __put_center(p, total_pkts_sent, 19);
+    *p++ = _mDelimiter;
+    if(pkts_remaining == INFINITY){
+        p = __put_center(p, "Infinity", 8, 26);
+    }
+    else{
+        p = __put_center(p, pkts_remaining, 26);
+    }
+    *p++ = _mDelimiter;
+    *p++ = '\n';
+    __append(row, p - row);
+}
+
+void Log::print_cycle_heading(size_t cycle)
+{
+    print("\n\nCycle : ");
+    print(itos(cycle));
+    print("\n============\n");
+}
+
+void Log::print_window_heading(size_t first, size_t last)
+{
+    print("\n\nCycles : ");
+    print(itos(first));
+    print(" - ");
+    print(itos(last));
+    print("\n============\n");
+}
+
+void Log::print_edge_window_heading()
+{
+    static const char* columns[] = {"Edge", "WEIGHT", "MIN TXed",
+        "AVG TXed", "MAX TXed", "TOTAL TXed"};
+    static const size_t widths[] = {20, 10, 11, 12, 11, 12};
+    static const std::string heading = __table_heading("EDGE STATISTICS ",
+            columns, widths, 6);
+    print(heading);
+}
+
+void Log::print_node_window_heading()
+{
+    static const char* columns[] = {"NODE #", "TOTAL RECV", "TOTAL SENT",
+        "MIN REMAINING", "AVG REMAINING", "MAX REMAINING"};
+    static const size_t widths[] = {10, 12, 12, 14, 14, 14};
+    static const std::string heading = __table_heading("NODE STATISTICS ",
+            columns, widths, 6);
+    print(heading);
+}
+
+void Log::print_edge_window(NodeID src, NodeID dest, EdgeWeight weight,
+        size_t min_pkts_txed, float avg_pkts_txed, size_t max_pkts_txed,
+        size_t total_pkts_txed)
+{
+    char edge[32];
+    char* p = __put_uint(edge, src);
+    std::memcpy(p, "--->", 4);
+    p = __put_uint(p + 4, dest);
+
+    char row[160];
+    p = __put_center(row, edge, p - edge, 20);
+    *p++ = _mDelimiter;
+    p = __put_center(p, (size_t)weight, 10);
+    *p++ = _mDelimiter;
+    p = __put_center(p, min_pkts_txed, 11);
+    *p++ = _mDelimiter;
+    p = __put_float_center(p, avg_pkts_txed, 12);
+    *p++ = _mDelimiter;
+    p = __put_center(p, max_pkts_txed, 11);
+    *p++ = _mDelimiter;
+    p = __put_center(p, total_pkts_txed, 12);
+    *p++ = _mDelimiter;
+    *p++ = '\n';
+    __append(row, p - row);
+}
+
+// The source has infinite pkts remaining
+void Log::print_node_window(NodeID id, size_t total_pkts_recv,
+        size_t total_pkts_sent, size_t min_pkts_remaining,
+        float avg_pkts_remaining, size_t max_pkts_remaining)
+{
+    char row[160];
+    char* p = __put_center(row, (size_t)id, 10);
+    *p++ = _mDelimiter;
+    p = __put_center(p, total_pkts_recv, 12);
+    *p++ = _mDelimiter;
+    p = __put_center(p, total_pkts_sent, 12);
+    *p++ = _mDelimiter;
+    if(min_pkts_remaining == INFINITY){
+        for (int i = 0; i < 3; ++i) {
+            p = __put_center(p, "Infinity", 8, 14);
+            *p++ = _mDelimiter;
+        }
+    }
+    else{
+        p = __put_center(p, min_pkts_remaining, 14);
+        *p++ = _mDelimiter;
+        p = __put_float_center(p, avg_pkts_remaining, 14);
+        *p++ = _mDelimiter;
+        p = __put_center(p, max_pkts_remaining, 14);
+        *p++ = _mDelimiter;
+    }
+    *p++ = '\n';
+    __append(row, p - row);
+}
+
+void Log::print_flow_heading(NodeID src, NodeID dest)
+{
+    print("\nFlow : ");
+    print(itos(src));
+    print(" ----> ");
+    print(itos(dest));
+    print("\n");
+}
+
+void Log::print_flow_statistics_heading()
+{
+    print("\n\nFlow statistics:\n");
+    print("================\n\n");
+}
+
+// Print the flow rate b/w src and dest. heading is to print the flow
+// when there are more flows
+void Log::print_flow_statistics(NodeID src, NodeID dest,
+        size_t pkts_sent, size_t pkts_recv, bool heading)
+{
+    if (heading) {
+        print("Flow : ");
+        print(itos(src));
+        print(" ----> ");
+        print(itos(dest));
+        print("\n");
+    }
+    print("Number of data sent from src\t:\t");
+    print(itos(pkts_sent));
+    print("\n");
+    print("Number of data received at dest\t:\t");
+    print(itos(pkts_recv));
+    print("\n");
+    print("Data flow rate from src to dest\t:\t");
+    if (pkts_sent){
+        print(ftos(((float)pkts_recv/(float)pkts_sent) * 100.00));
+        print("%\n\n");
+    }
+    else{
+        print("0.0%\n\n");
+    }
+}
+
+// Print the max flow b/w src and dest and the data received per
+// cycle to it
+void Log::print_max_flow_ratio(size_t max_flow, size_t pkts_recv,
+        size_t cycles)
+{
+    float rate = cycles ? (float)pkts_recv / (float)cycles : 0;
+    print("Max flow from src to dest\t:\t");
+    print(itos(max_flow));
+    print("\n");
+    print("Data received per cycle\t\t:\t");
+    print(ftos(rate));
+    print("\n");
+    print("Data rate to max flow\t\t:\t");
+    if (max_flow){
+        print(ftos((rate / (float)max_flow) * 100.00));
+        print("%\n\n");
+    }
+    else{
+        print("0.0%\n\n");
+    }
+}
+
+void Log::write(const char* data, size_t len)
+{
+    __append(data, len);
+}
+
+// Write the number as unsigned LEB128
+void Log::write_varint(size_t n)
+{
+    char buf[10];
+    size_t len = 0;
+    while (n >= 0x80) {
+        buf[len++] = (char)(n | 0x80);
+        n >>= 7;
+    }
+    buf[len++] = (char)n;
+    __append(buf, len);
+}
+
+/**********************************************************************
+ *                     SimulationStats methods                        *
+ **********************************************************************/
+void SimulationStats::clear()
+{
+    flows = 0;
+    cycles = 0;
+    cycles_skipped = 0;
+    setup_time = 0;
+    arbitration_time = 0;
+    consumption_time = 0;
+    format_time = 0;
+    log_io_time = 0;
+    nodes_arbitrated = 0;
+    nodes_consumed = 0;
+    edges_visited = 0;
+    distribute_loops = 0;
+}
+
+void SimulationStats::add(const SimulationStats& stats)
+{
+    flows += stats.flows;
+    cycles += stats.cycles;
+    cycles_skipped += stats.cycles_skipped;
+    setup_time += stats.setup_time;
+    arbitration_time += stats.arbitration_time;
+    consumption_time += stats.consumption_time;
+    format_time += stats.format_time;
+    log_io_time += stats.log_io_time;
+    nodes_arbitrated += stats.nodes_arbitrated;
+    nodes_consumed += stats.nodes_consumed;
+    edges_visited += stats.edges_visited;
+    distribute_loops += stats.distribute_loops;
+}
+
+void SimulationStats::get_rows(
+        std::vector<std::pair<std::string, std::string> >& rows) const
+{
+    const char* names[] = {"Setup (ms)", "Arbitration (ms)",
+        "Consumption (ms)", "Formatting (ms)", "Log I/O (ms)"};
+    const uint64_t times[] = {setup_time, arbitration_time,
+        consumption_time, format_time, log_io_time};
+    rows.clear();
+    rows.push_back(std::make_pair("Flows", Log::itos(flows)));
+    rows.push_back(std::make_pair("Cycles", Log::itos(cycles)));
+    rows.push_back(std::make_pair("Cycles fast-forwarded",
+                Log::itos(cycles_skipped)));
+    for (size_t k = 0; k < 5; ++k) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", times[k] / 1e6);
+        rows.push_back(std::make_pair(names[k], buf));
+    }
+    rows.push_back(std::make_pair("Nodes arbitrated", Log::itos(nodes_arbitrated)));
+    rows.push_back(std::make_pair("Nodes consumed", Log::itos(nodes_consumed)));
+    rows.push_back(std::make_pair("Edges visited", Log::itos(edges_visited)));
+    rows.push_back(std::make_pair("Distribute loops", Log::itos(distribute_loops)));
+}
+
+void SimulationStats::write_json(std::ostream& out, const char* indent) const
+{
+    out << "{\n";
+    out << indent << "  \"flows\": " << flows << ",\n";
+    out << indent << "  \"cycles\": " << cycles << ",\n";
+    out << indent << "  \"cycles_skipped\": " << cycles_skipped << ",\n";
+    out << indent << "  \"setup_ns\": " << setup_time << ",\n";
+    out << indent << "  \"arbitration_ns\": " << arbitration_time << ",\n";
+    out << indent << "  \"consumption_ns\": " << consumption_time << ",\n";
+    out << indent << "  \"format_ns\": " << format_time << ",\n";
+    out << indent << "  \"log_io_ns\": " << log_io_time << ",\n";
+    out << indent << "  \"nodes_arbitrated\": " << nodes_arbitrated << ",\n";
+    out << indent << "  \"nodes_consumed\": " << nodes_consumed << ",\n";
+    out << indent << "  \"edges_visited\": " << edges_visited << ",\n";
+    out << indent << "  \"distribute_loops\": " << distribute_loops << "\n";
+    out << indent << "}";
+}
+
+/**********************************************************************
+ *                     FlowPlan methods                               *
+ **********************************************************************/
+void FlowPlan::clear()
+{
+    node_ids.clear();
+    nodes.clear();
+    member.clear();
+    out_offsets.clear();
+    weights.clear();
+    edge_src.clear();
+    edge_dest.clear();
+    edges.clear();
+    node_flow_offsets.clear();
+    flow_nodes.clear();
+    flow_edges.clear();
+    in_edges.clear();
+}
+
+/**********************************************************************
+ *                     Barrier class methods                          *
+ **********************************************************************/
+void Barrier::wait()
+{
+    std::unique_lock<std::mutex> lock(__mMutex);
+    size_t generation = __mGeneration;
+    if (++__mWaiting == __mCount) {
+        // Last thread releases the others
+        __mWaiting = 0;
+        ++__mGeneration;
+        __mCond.notify_all();
+        return;
+    }
+    while (generation == __mGeneration) {
+        __mCond.wait(lock);
+    }
+}
+
+/**********************************************************************
+ *                     Simulation class methods                       *
+ **********************************************************************/
+// Update source and destination for a single flow
+bool Simulation::update_src_and_dest(NodeID src, NodeID dest,
+        size_t max_paths)
+{
+    __mFlows.clear();
+    add_flow(src, dest);
+    return setup_flows(max_paths);
+}
+
+NodeID Simulation::get_src()
+{
+    return __mSrc;
+}
+
+NodeID Simulation::get_dest()
+{
+    return __mDest;
+}
+
+// Add a flow. It will be set up when the simulation starts
+void Simulation::add_flow(NodeID src, NodeID dest)
+{
+    __mSrc = src;
+    __mDest = dest;
+    __mFlows.push_back(Flow(src, dest));
+}
+
+size_t Simulation::get_flow_count()
+{
+    return __mFlows.size();
+}
+
+// Open file for logging the statistics. Named after the flow
+// if there is only one
+bool Simulation::__open_log()
+{
+    std::string file;
+    if (__mFlows.size() == 1) {
+        file.append("flow_");
+        file.append(Log::itos(__mFlows[0].src_id));
+        file.append("_to_");
+        file.append(Log::itos(__mFlows[0].dest_id));
+        file.append("_");
+    }
+    else {
+        file.append("flows_");
+    }
+
+    //append timestamp
+    time_t     now = time(0);
+    struct tm  tstruct;
+    char       buf[80];
+    tstruct = *localtime(&now);
+    strftime(buf, sizeof(buf), "%Y-%m-%d.%X", &tstruct);
+    file.append(buf);
+    file.append((__mOptions.format == STATS_BINARY) ? ".stats" : ".log");
+
+    __mLogFile = file;
+    return Log::open(file);
+}
+
+// Set up all added flows. Flows without path to the destination
+// are dropped
+bool Simulation::setup_flows(size_t max_paths)
+{
+    if(!__open_log()) {
+        std::cout << "\nError: Failed to create log file for flow\n";
+        return false;
+    }
+    if (__mOptions.format == STATS_BINARY) {
+        Log::write(STATS_MAGIC, STATS_MAGIC_SIZE);
+    }
+
+    // The flows are set up from the frozen form of created graph
+    if (__mGraph) {
+        __mImage = &__mGraph->freeze();
+    }
+
+    std::vector<Flow> flows;
+    std::vector<NodeIDList> node_sets;
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        Flow& flow = __mFlows[f];
+        NodeIDList node_set;
+
+        // Update all nodes that involves in the current flow
+        __print_flow_heading(flow);
+        __update_node_set(flow, node_set, max_paths);
+
+        if(!node_set.size()){
+            std::cout << "\nInfo : No path to reach destination " << flow.dest_id;
+            std::cout << " from source " << flow.src_id << "\n\n";
+            continue;
+        }
+        flows.push_back(flow);
+        node_sets.push_back(NodeIDList());
+        node_sets.back().swap(node_set);
+    }
+    __mFlows.swap(flows);
+
+    if(!__mFlows.size()){
+        __mPlan.clear();
+        Log::close();
+        std::remove(__mLogFile.c_str());
+        return false;
+    }
+
+    // Build the execution plan of the flows
+    __build_plan(node_sets);
+
+    // Reset total pkt transferred and received for nodes
+    reset_counters();
+
+    if (__mOptions.format == STATS_BINARY) {
+        __write_stats_header();
+    }
+    return true;
+}
+
+// Print the flow that follows, when more than one flow is simulated
+void Simulation::__print_flow_heading(Flow& flow)
+{
+    if (__mFlows.size() > 1) {
+        Log::print_flow_heading(flow.src_id, flow.dest_id);
+    }
+}
+
+// Private version
+void Simulation::__update_node_set(Flow& flow, NodeIDList& node_set,
+        size_t max_paths)
+{
+    node_set = __mImage->get_involved_nodes(flow.src_id, flow.dest_id);
+
+    // Listing the paths is optional as their count can grow
+    // exponentially with the graph size
+    if (max_paths) {
+        // Print the paths from src to dest as they are found
+        Log::print("List of paths the data will be transfering:\n");
+        Log::print("-------------------------------------------\n");
+
+        PathIterator paths(*__mImage, flow.src_id, flow.dest_id,
+                __mOptions.path_order);
+        paths.set_time_limit(__mOptions.path_time);
+        Path path;
+        size_t count = 0;
+        while ((count < max_paths) && paths.next(path)) {
+            std::string str;
+            for (size_t j = 0; j < path.size(); ++j) {
+                str.append(Log::itos(path[j]));
+                str.append(" ----> ");
+            }
+            Log::print(str);
+            Log::print("\n");
+            ++count;
+        }
+        // Listing is cut by the limit only if there is one more path
+        if ((count == max_paths) && paths.next(path)) {
+            Log::print("(Listing is limited to ");
+            Log::print(Log::itos(max_paths));
+            Log::print(" paths)\n");
+        }
+        else if (paths.timed_out()) {
+            Log::print("(Listing is stopped after ");
+            Log::print(Log::itos(__mOptions.path_time));
+            Log::print(" ms)\n");
+        }
+    }
+    else {
+        // Print the nodes involved in the flow
+        Log::print("Nodes involved in the data flow:\n");
+        Log::print("--------------------------------\n");
+
+        std::string str;
+        for (size_t i = 0; i < node_set.size(); ++i) {
+            str.append(Log::itos(node_set[i]));
+            str.append(" ");
+        }
+        Log::print(str);
+        Log::print("\n");
+    }
+}
+
+// Flatten the involved nodes and the edges between them into the
+// plan. All filtering and node lookups are done here, once. The
+// graph is flattened once for all flows; a flow only adds its
+// nodes and edges to the plan
+void Simulation::__build_plan(std::vector<NodeIDList>& node_sets)
+{
+    FlowPlan& plan = __mPlan;
+    GraphImage& image = *__mImage;
+    plan.clear();
+
+    size_t npos = (size_t)-1;
+
+    // Nodes involved in any flow, in ascending node id order
+    NodeIDList ids;
+    for (size_t f = 0; f < node_sets.size(); ++f) {
+        ids.insert(ids.end(), node_sets[f].begin(), node_sets[f].end());
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<size_t> index(image.node_count(), npos);
+    plan.member.assign(image.node_count(), false);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        size_t node = image.find_node(ids[i]);
+        index[node] = plan.nodes.size();
+        plan.member[node] = true;
+        plan.node_ids.push_back(ids[i]);
+        plan.nodes.push_back(node);
+    }
+
+    size_t node_count = plan.node_count();
+
+    // Out edges whose destination is involved
+    std::vector<size_t> edge_index(image.edge_count(), npos);
+    size_t max_out_edges = 0;
+    plan.out_offsets.push_back(0);
+    for (size_t i = 0; i < node_count; ++i) {
+        size_t node = plan.nodes[i];
+        for (size_t e = image.out_begin(node); e < image.out_end(node); ++e) {
+            size_t dest = image.edge_dest(e);
+            if(plan.member[dest]) {
+                edge_index[e] = plan.edge_count();
+                plan.weights.push_back(image.weight(e));
+                plan.edge_src.push_back(i);
+                plan.edge_dest.push_back(index[dest]);
+                plan.edges.push_back(e);
+            }
+        }
+        plan.out_offsets.push_back(plan.edge_count());
+        max_out_edges = std::max(max_out_edges,
+                plan.out_offsets[i+1] - plan.out_offsets[i]);
+    }
+
+    // Nodes of flows grouped by node, in order of flows
+    plan.node_flow_offsets.assign(node_count + 1, 0);
+    for (size_t f = 0; f < node_sets.size(); ++f) {
+        for (size_t k = 0; k < node_sets[f].size(); ++k) {
+            ++plan.node_flow_offsets[index[image.find_node(
+                    node_sets[f][k])] + 1];
+        }
+    }
+    for (size_t i = 0; i < node_count; ++i) {
+        plan.node_flow_offsets[i+1] += plan.node_flow_offsets[i];
+    }
+
+    std::vector<size_t> position(plan.node_flow_offsets.begin(),
+            plan.node_flow_offsets.end() - 1);
+    plan.flow_nodes.resize(plan.node_flow_offsets.back());
+    for (size_t f = 0; f < node_sets.size(); ++f) {
+        Flow& flow = __mFlows[f];
+        flow.nodes.clear();
+        for (size_t k = 0; k < node_sets[f].size(); ++k) {
+            size_t i = index[image.find_node(node_sets[f][k])];
+            size_t m = position[i]++;
+            plan.flow_nodes[m].flow = f;
+            plan.flow_nodes[m].node = i;
+            flow.nodes.push_back(m);
+            if (node_sets[f][k] == flow.src_id) {
+                flow.src = m;
+            }
+            if (node_sets[f][k] == flow.dest_id) {
+                flow.dest = m;
+            }
+        }
+    }
+
+    // Edges of the flows. Counted first to lay them out
+    // in order of flow nodes, then filled
+    std::vector<size_t> at(node_count, npos);
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        __build_flow_edges(__mFlows[f], at, edge_index, false);
+    }
+    size_t out_count = 0;
+    size_t in_count = 0;
+    for (size_t m = 0; m < plan.flow_nodes.size(); ++m) {
+        FlowNode& flow_node = plan.flow_nodes[m];
+        flow_node.out_begin = out_count;
+        out_count += flow_node.out_end;
+        flow_node.out_end = out_count;
+        flow_node.in_begin = in_count;
+        in_count += flow_node.in_end;
+        flow_node.in_end = in_count;
+    }
+    plan.flow_edges.resize(out_count);
+    plan.in_edges.resize(in_count);
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        __build_flow_edges(__mFlows[f], at, edge_index, true);
+    }
+
+    __mEdgeUsed.assign(plan.edge_count(), 0);
+    __mMaxOutEdges = max_out_edges;
+}
+
+// Count (or fill) the out and in edges of each node of the flow.
+// The out edges are the edges to the nodes of the flow; the in edges
+// are kept in the order of in edge list of the destination, as that
+// is the order they are reported
+void Simulation::__build_flow_edges(Flow& flow, std::vector<size_t>& at,
+        std::vector<size_t>& edge_index, bool fill)
+{
+    FlowPlan& plan = __mPlan;
+    GraphImage& image = *__mImage;
+    size_t npos = (size_t)-1;
+
+    // Flow node of each plan node in this flow
+    for (size_t k = 0; k < flow.nodes.size(); ++k) {
+        at[plan.flow_nodes[flow.nodes[k]].node] = flow.nodes[k];
+    }
+
+    for (size_t k = 0; k < flow.nodes.size(); ++k) {
+        FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+        size_t i = flow_node.node;
+
+        size_t out = 0;
+        for (size_t e = plan.out_offsets[i]; e < plan.out_offsets[i+1]; ++e) {
+            if (at[plan.edge_dest[e]] != npos) {
+                if (fill) {
+                    plan.flow_edges[flow_node.out_begin + out] = e;
+                }
+                ++out;
+            }
+        }
+        if (!fill) {
+            flow_node.out_end = out;
+        }
+    }
+
+    // In edges refer the out edges, so they are done after all out edges
+    for (size_t k = 0; k < flow.nodes.size(); ++k) {
+        FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+        size_t i = flow_node.node;
+
+        size_t in = 0;
+        size_t node = plan.nodes[i];
+        for (size_t j = image.in_begin(node); j < image.in_end(node); ++j) {
+            size_t e = edge_index[image.in_edge(j)];
+            if ((e == npos) || (at[plan.edge_src[e]] == npos)) {
+                continue;
+            }
+            if (fill) {
+                // Flow edges at the source are in plan edge order
+                FlowNode& src = plan.flow_nodes[at[plan.edge_src[e]]];
+                std::vector<size_t>::iterator eIter = std::lower_bound(
+                        plan.flow_edges.begin() + src.out_begin,
+                        plan.flow_edges.begin() + src.out_end, e);
+                plan.in_edges[flow_node.in_begin + in] =
+                    eIter - plan.flow_edges.begin();
+            }
+            ++in;
+        }
 
-bool Log::open(std::string& file)
-{
-    if(file.size()){
-        _mCout.open(file.c_str(), std::ofstream::out);
-        if(!_mCout.fail()){
-            return true;
+        if (!fill) {
+            flow_node.in_end = in;
         }
     }
-    return false;
-}
 
-void Log::close()
-{
-    _mCout.close();
+    for (size_t k = 0; k < flow.nodes.size(); ++k) {
+        at[plan.flow_nodes[flow.nodes[k]].node] = npos;
+    }
 }
 
-std::string Log::ftos(float n)
+// Print the edges that deliver data to nodes. Source is
+// excluded as it never consumes data
+void Simulation::print_edge_statistics(Flow& flow)
 {
-    std::ostringstream s;
-    s << n;
-    return s.str();
+    FlowPlan& plan = __mPlan;
+    for (size_t k = 0; k < flow.nodes.size(); ++k) {
+        if(flow.nodes[k] == flow.src) {
+            continue;
+        }
+        FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+        for (size_t j = flow_node.in_begin; j < flow_node.in_end; ++j) {
+            size_t x = plan.in_edges[j];
+            size_t e = plan.flow_edges[x];
+            Log::print_edge_statistics(plan.node_ids[plan.edge_src[e]],
+                    plan.node_ids[plan.edge_dest[e]], plan.weights[e],
+                    __mPktsTransferred[x], __mTotalPktsTransferred[x]);
+        }
+    }
 }
 
-std::string Log::itos(size_t n)
+// Print all node statistics
+void Simulation::print_node_statistics(Flow& flow)
 {
-    std::ostringstream s;
-    s << n;
-    return s.str();
+    FlowPlan& plan = __mPlan;
+    for (size_t k = 0; k < flow.nodes.size(); ++k) {
+        size_t m = flow.nodes[k];
+        Log::print_node_statistics(plan.node_ids[plan.flow_nodes[m].node],
+                __mTotalPktsRecv[m], __mTotalPktsSent[m], __mPktsToBeSent[m]);
+    }
 }
 
-void Log::print(const std::string& str)
+// Reset the counters of all flows. The source has
+// infinite pkts to be sent
+void Simulation::reset_counters()
 {
-    _mCout << str ;
+    __mPktsTransferred.assign(__mPlan.flow_edges.size(), 0);
+    __mTotalPktsTransferred.assign(__mPlan.flow_edges.size(), 0);
+    __mPktsToBeSent.assign(__mPlan.flow_nodes.size(), 0);
+    __mTotalPktsRecv.assign(__mPlan.flow_nodes.size(), 0);
+    __mTotalPktsSent.assign(__mPlan.flow_nodes.size(), 0);
+
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        __mPktsToBeSent[__mFlows[f].src] = INFINITY;
+    }
 }
 
-// Print the given string in the center of given width
-// Will be used to print table
-std::string Log::center(const std::string str, int width)
+// Copy the counters to the counters of the graph so that they hold
+// the statistics of last simulation (summed over the flows)
+void Simulation::__write_back_counters()
 {
-    std::stringstream ss, spaces;
-    int padding = width - str.size();
+    // Opened image is read-only
+    if (__mGraph == NULL) {
+        return;
+    }
+
+    FlowPlan& plan = __mPlan;
+    GraphCounters& counters = __mGraph->get_counters();
+    counters.reset(__mGraph->get_node_index_bound(),
+            __mGraph->get_edge_index_bound());
+    for (size_t i = 0; i < plan.node_count(); ++i) {
+        size_t index = __mImage->get_node(plan.nodes[i])->get_index();
+        size_t pkt_tbs = 0;
+        for (size_t m = plan.node_flow_offsets[i];
+                m < plan.node_flow_offsets[i+1]; ++m) {
+            counters.total_pkts_recv[index] += __mTotalPktsRecv[m];
+            counters.total_pkts_sent[index] += __mTotalPktsSent[m];
+            if ((pkt_tbs == INFINITY) || (__mPktsToBeSent[m] == INFINITY)) {
+                pkt_tbs = INFINITY;
+            }
+            else {
+                pkt_tbs += __mPktsToBeSent[m];
+            }
+        }
+        counters.pkts_to_be_sent[index] = pkt_tbs;
+    }
 
-    for(int i=0; i<padding/2; ++i){
-        spaces << " ";
+    for (size_t x = 0; x < plan.flow_edges.size(); ++x) {
+        size_t index =
+            __mImage->get_edge(plan.edges[plan.flow_edges[x]])->get_index();
+        counters.pkts_transferred[index] += __mPktsTransferred[x];
+        counters.total_pkts_transferred[index] += __mTotalPktsTransferred[x];
+    }
+}
+
+// Start the data flow b/w src and dest for given number of cycle.
+// The flows added already are kept for later
+void Simulation::start(NodeID src, NodeID dest, size_t no_of_cylce,
+        const FlowOptions& options)
+{
+    std::vector<Flow> added;
+    added.swap(__mFlows);
+    add_flow(src, dest);
+    start(no_of_cylce, options);
+    __mFlows.swap(added);
+}
+
+// Start the data flow of all added flows for given number of cycle
+void Simulation::start(size_t no_of_cylce, const FlowOptions& options)
+{
+    __mOptions = options;
+    __mCycles = no_of_cylce;
+    __mWindowCycles = 0;
+    __mCycleStats.clear();
+    __mFlowStats.clear();
+# ifdef SIMULATION_STATS
+    uint64_t write_time = Log::get_write_time();
+# endif
+    STATS_TIMER(setup);
+    if(!setup_flows(options.max_paths)){
+        __mFlows.clear();
+        return;
     }
+    STATS_ELAPSED(__mFlowStats.setup_time, setup);
+    STATS_ADD(__mFlowStats.flows, __mFlows.size());
+
+    // Run the cycles. The first worker runs in this thread
+    __setup_workers(options.threads);
+
+    // Arbitration order at a node repeats in the no of flows at it
+    // cycles, so at all nodes in the lcm of them
+    __mPhase = options.steady ? 1 : 0;
+    for (size_t i = 0; (i < __mPlan.node_count()) && __mPhase; ++i) {
+        size_t count = __mPlan.node_flow_offsets[i+1] - __mPlan.node_flow_offsets[i];
+        __mPhase = std::lcm(__mPhase, std::max(count, (size_t)1));
+        if (__mPhase > STEADY_MAX_PERIOD) {
+            __mPhase = 0;
+        }
+    }
+    __mCycleHashes.assign(STEADY_MAX_PERIOD + 1, 0);
+    __mRepeats.assign(STEADY_MAX_PERIOD + 1, 0);
+    __mPeriod = 0;
+    __mSteadyCycles = 0;
+
+    Barrier barrier(__mWorkers.size());
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < __mWorkers.size(); ++w) {
+        threads.push_back(std::thread(&Simulation::__run_worker, this, w,
+                    no_of_cylce, std::ref(barrier)));
+    }
+    __run_worker(0, no_of_cylce, barrier);
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    if (__mSteadyCycles) {
+        STATS_TIMER(format);
+        __fast_forward();
+        STATS_ELAPSED(__mFlowStats.format_time, format);
+        STATS_ADD(__mFlowStats.cycles_skipped, __mCycles - __mSteadyCycles);
+    }
+    std::vector<size_t>().swap(__mPeriodStates);
+
+    __write_back_counters();
 
-    ss << spaces.str() << str << spaces.str();
+    // Print the flow rate b/w src and dest at end of flow
+    if (__mOptions.format == STATS_BINARY) {
+        __write_flow_stats();
+    }
+    else {
+        Log::print_flow_statistics_heading();
+        for (size_t f = 0; f < __mFlows.size(); ++f) {
+            __print_flow_statistics(__mFlows[f]);
+        }
+    }
 
-    if(padding>0 && padding%2!=0){
-        ss << " ";
+    // Close the log
+    Log::close();
+    STATS_ADD(__mFlowStats.log_io_time, Log::get_write_time() - write_time);
+    __mTotalStats.add(__mFlowStats);
+    if (__mOptions.stats_file.size()) {
+        write_stats(__mOptions.stats_file);
     }
-    return ss.str();
+
+    // Flows are simulated. New flows can be added
+    __mFlows.clear();
 }
 
-// Print the heading of the table
-// It will be printed for every cycle
-void Log::print_node_statistics_heading()
+void Simulation::__print_flow_statistics(Flow& flow)
 {
-    std::string fill(_mTotalWidth, '-');
-    std::string space((_mTotalWidth-30)/2, ' ');
-    _mCout << "\n";
-    _mCout << space << "NODE STATISTICS " << space << "\n";
-    _mCout << fill << "\n";
-    // Print heading information
-    _mCout << center("NODE #", 10) << "|";
-    _mCout << center("TOTAL PKTs RECEIVED", 23) << "|";
-    _mCout << center("TOTAL PKTs SENT", 19) << "|";
-    _mCout << center("TOTAL PKTs REMAINING", 26) << "|\n";
-    _mCout << fill << "\n";
+    Log::print_flow_statistics(flow.src_id, flow.dest_id,
+            __mTotalPktsSent[flow.src], __mTotalPktsRecv[flow.dest],
+            __mFlows.size() > 1);
+    // Max flow of the flow alone, as if no other flow shares the edges
+    if (__mOptions.ratio) {
+        Log::print_max_flow_ratio(
+                __mImage->max_flow(flow.src_id, flow.dest_id),
+                __mTotalPktsRecv[flow.dest], __mCycles);
+    }
 }
 
-void Log::print_edge_statistics_heading()
+// Divide the nodes b/w workers. Each worker gets a contiguous range
+// of nodes with about the same number of flow edges
+void Simulation::__setup_workers(size_t threads)
 {
-    std::string fill(_mTotalWidth, '-');
-    std::string space((_mTotalWidth-30)/2, ' ');
-    _mCout << "\n";
-    _mCout << space << "EDGE STATISTICS " << space << "\n";
-    _mCout << fill << "\n";
-    // Print heading information
-    _mCout << center("Edge", 20) << "|";
-    _mCout << center("WEIGHT", 18) << "|";
-    _mCout << center("# PKTs TXed", 20) << "|";
-    _mCout << center("TOTAL PKTs TXed", 20) << "|\n";
-    _mCout << fill << "\n";
+    FlowPlan& plan = __mPlan;
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = std::min(threads, plan.node_count());
+    threads = std::max(threads, (size_t)1);
+
+    // Work of a node is its flow nodes and their edges
+    size_t total = 0;
+    std::vector<size_t> work(plan.node_count(), 0);
+    for (size_t i = 0; i < plan.node_count(); ++i) {
+        for (size_t m = plan.node_flow_offsets[i];
+                m < plan.node_flow_offsets[i+1]; ++m) {
+            FlowNode& flow_node = plan.flow_nodes[m];
+            work[i] += 1 + (flow_node.out_end - flow_node.out_begin)
+                + (flow_node.in_end - flow_node.in_begin);
+        }
+        total += work[i];
+    }
+
+    __mWorkers.assign(threads, Worker());
+    size_t node = 0;
+    size_t done = 0;
+    for (size_t w = 0; w < threads; ++w) {
+        Worker& worker = __mWorkers[w];
+        worker.node_begin = node;
+        size_t target = (total * (w + 1)) / threads;
+        while ((node < plan.node_count()) &&
+                ((w + 1 == threads) || (done < target))) {
+            done += work[node++];
+        }
+        worker.node_end = node;
+        worker.residual.resize(__mMaxOutEdges);
+        worker.scratch.resize(__mMaxOutEdges);
+    }
+
+    // Nodes with pkts to be sent are active in first cycle
+    __mNodeWorker.resize(plan.node_count());
+    __mConsumedAt.assign(plan.node_count(), 0);
+    __mActiveAt.assign(plan.node_count(), 0);
+    for (size_t w = 0; w < threads; ++w) {
+        Worker& worker = __mWorkers[w];
+        worker.outbox.resize(threads);
+        for (size_t i = worker.node_begin; i < worker.node_end; ++i) {
+            __mNodeWorker[i] = w;
+            if (__is_active(i)) {
+                worker.active.push_back(i);
+            }
+        }
+    }
 }
 
-/**********************************************************************
- *                     Simulation class methods                       *
- **********************************************************************/
-// Update source and destination for current flow
-bool Simulation::update_src_and_dest(NodeID src, NodeID dest)
+// Cycle loop of a worker. The workers meet at the barrier after each
+// phase, so the result is same for any number of workers
+void Simulation::__run_worker(size_t worker, size_t no_of_cylce,
+        Barrier& barrier)
 {
-    Node* src_node = __mGraph->get_node_from_id(src);
-    Node* dest_node = __mGraph->get_node_from_id(dest);
+    // Time of a phase includes the wait for the other workers
+    for (size_t i = 0; i < no_of_cylce; ++i) {
+        // Start to send the data b/w nodes (phase-1)
+        STATS_TIMER(arbitration);
+        __start_arbitration(i, __mWorkers[worker]);
+        barrier.wait();
+        STATS_ELAPSED(__mWorkers[worker].stats.arbitration_time, arbitration);
 
-    __mSrc = src;
-    __mDest = dest;
+        // Consume the data from nodes(phase-2)
+        STATS_TIMER(consumption);
+        __start_consumption(i, worker);
+        barrier.wait();
+        STATS_ELAPSED(__mWorkers[worker].stats.consumption_time, consumption);
+
+        // Counters of the cycle are logged before next cycle
+        if (worker == 0) {
+            STATS_TIMER(format);
+            __print_cycle(i);
+            STATS_ELAPSED(__mWorkers[worker].stats.format_time, format);
+# ifdef SIMULATION_STATS
+            __collect_cycle_stats();
+# endif
+            if (__mPhase) {
+                __detect_steady_state(i);
+            }
+        }
+        barrier.wait();
 
-    // Open file for logging the statistics
-    std::string file("flow_");
-    file.append(Log::itos(src));
-    file.append("_to_");
-    file.append(Log::itos(dest));
-    file.append("_");
+        // Cycles left are fast-forwarded
+        if (__mSteadyCycles) {
+            break;
+        }
+    }
+}
 
-    //append timestamp
-    time_t     now = time(0);
-    struct tm  tstruct;
-    char       buf[80];
-    tstruct = *localtime(&now);
-    strftime(buf, sizeof(buf), "%Y-%m-%d.%X", &tstruct);
-    file.append(buf);
-    file.append(".log");
+// Stats of the cycle are the counters of all workers and the times of
+// the first worker
+void Simulation::__collect_cycle_stats()
+{
+    __mCycleStats = __mWorkers[0].stats;
+    __mCycleStats.cycles = 1;
+    __mWorkers[0].stats.clear();
+    for (size_t w = 1; w < __mWorkers.size(); ++w) {
+        SimulationStats& stats = __mWorkers[w].stats;
+        __mCycleStats.nodes_arbitrated += stats.nodes_arbitrated;
+        __mCycleStats.nodes_consumed += stats.nodes_consumed;
+        __mCycleStats.edges_visited += stats.edges_visited;
+        __mCycleStats.distribute_loops += stats.distribute_loops;
+        stats.clear();
+    }
+    __mFlowStats.add(__mCycleStats);
+}
+
+// Print the stats of last cycle, last start and all starts
+void Simulation::print_stats(std::ostream& out)
+{
+# ifndef SIMULATION_STATS
+    out << "\nInfo : Instrumentation is not built in (make STATS=yes)\n";
+# else
+    std::vector<std::pair<std::string, std::string> > cycle, flow, total;
+    __mCycleStats.get_rows(cycle);
+    __mFlowStats.get_rows(flow);
+    __mTotalStats.get_rows(total);
+
+    out << "\nSimulation statistics:\n";
+    out << "======================\n";
+    out << std::left << std::setw(24) << "" << std::right
+        << std::setw(16) << "Last cycle" << std::setw(16) << "Last start"
+        << std::setw(16) << "All starts" << "\n";
+    for (size_t k = 0; k < total.size(); ++k) {
+        out << std::left << std::setw(24) << total[k].first << std::right
+            << std::setw(16) << cycle[k].second
+            << std::setw(16) << flow[k].second
+            << std::setw(16) << total[k].second << "\n";
+    }
+    out << std::left;
+# endif
+}
 
-    if(!Log::open(file)) {
-        std::cout << "\nError: Failed to create log file for flow\n";
+// Write the stats as JSON
+bool Simulation::write_stats(const std::string& file)
+{
+    std::ofstream out(file.c_str());
+    if (out.fail()) {
+        std::cout << "\nError: Failed to create file " << file << "\n";
         return false;
     }
+# ifdef SIMULATION_STATS
+    out << "{\n  \"enabled\": true,\n";
+# else
+    out << "{\n  \"enabled\": false,\n";
+# endif
+    out << "  \"last_cycle\": ";
+    __mCycleStats.write_json(out, "  ");
+    out << ",\n  \"last_start\": ";
+    __mFlowStats.write_json(out, "  ");
+    out << ",\n  \"all_starts\": ";
+    __mTotalStats.write_json(out, "  ");
+    out << "\n}\n";
+    return true;
+}
 
-    // Clear the filtered node list of previous flow
-    __mNodeSet.clear();
+// Log the counters of the cycle as per the options. The last cycle
+// is always logged
+void Simulation::__print_cycle(size_t cycle)
+{
+    bool last = (cycle + 1 == __mCycles);
+    if (__mOptions.window) {
+        __update_window();
+        if (((cycle + 1) % __mOptions.window == 0) || last) {
+            __print_window(cycle);
+        }
+        return;
+    }
+    if (__mOptions.every && ((cycle + 1) % __mOptions.every) && !last) {
+        return;
+    }
+    if (__mOptions.format == STATS_BINARY) {
+        __write_cycle_stats(cycle);
+        return;
+    }
 
-    // Update all nodes that involves in the current flow
-    __update_node_set(src, dest);
+    //Print the header info
+    Log::print_cycle_heading(cycle+1);
 
-    // Reset total pkt transferred and received for nodes
-    reset_counters();
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        __print_flow_heading(__mFlows[f]);
 
-    if(!__mNodeSet.size()){
-        std::cout << "\nInfo : No path to reach destination " << __mDest;
-        std::cout << " from source " << __mSrc << "\n\n";
-        Log::close();
-        std::remove(file.c_str());
-        return false;
-    }
+        // Print the edge statistics
+        Log::print_edge_statistics_heading();
+        print_edge_statistics(__mFlows[f]);
 
-    // Set the number of pkts to be sent to infinity
-    // (999999 max no) for source node
-    src_node->set_no_pkts_to_be_sent(INFINITY);
+        // Print node statistics heading
+        Log::print_node_statistics_heading();
 
-    return true;
+        // Print all node statistics
+        print_node_statistics(__mFlows[f]);
+    }
 }
 
-// Private version
-void Simulation::__update_node_set(NodeID src, NodeID dest)
+// Write the rows of the statistics tables of each flow (binary)
+void Simulation::__write_stats_header()
 {
-    std::vector<Path> nPaths = __mGraph->get_paths(src, dest);
+    FlowPlan& plan = __mPlan;
+    Log::write("", 1);
+    Log::write_varint(__mFlows.size());
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        Flow& flow = __mFlows[f];
+        Log::write_varint(flow.src_id);
+        Log::write_varint(flow.dest_id);
 
-    // Print all paths from src to dest
-    Log::print("List of paths the data will be transfering:\n");
-    Log::print("-------------------------------------------\n");
+        // Edge rows are in order of print_edge_statistics
+        size_t rows = 0;
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            if(flow.nodes[k] != flow.src) {
+                FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+                rows += flow_node.in_end - flow_node.in_begin;
+            }
+        }
+        Log::write_varint(rows);
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            if(flow.nodes[k] == flow.src) {
+                continue;
+            }
+            FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+            for (size_t j = flow_node.in_begin; j < flow_node.in_end; ++j) {
+                size_t e = plan.flow_edges[plan.in_edges[j]];
+                Log::write_varint(plan.node_ids[plan.edge_src[e]]);
+                Log::write_varint(plan.node_ids[plan.edge_dest[e]]);
+                Log::write_varint(plan.weights[e]);
+            }
+        }
 
-    // Get all paths b/w src and dest from graph and update
-    // node set with unique node ids (to process the data flow)
-    for (int i = 0; i < nPaths.size(); ++i) {
-        std::string str;
-        for (int j = 0; j < nPaths[i].size(); ++j) {
-            NodeID id = nPaths[i][j];
-            str.append(Log::itos(id));
-            str.append(" ----> ");
-            __mNodeSet.insert(id);
+        Log::write_varint(flow.nodes.size());
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            Log::write_varint(plan.node_ids[plan.flow_nodes[flow.nodes[k]].node]);
         }
-        Log::print(str);
-        Log::print("\n");
     }
-}
 
-NodeID Simulation::get_src()
-{
-    return __mSrc;
+    // Counters written are the changes from last cycle written
+    __mLastEdgeTotals.assign(plan.flow_edges.size(), 0);
+    __mLastNodeCounters.assign(3 * plan.flow_nodes.size(), 0);
 }
 
-NodeID Simulation::get_dest()
+// Write the counters of the cycle (binary)
+void Simulation::__write_cycle_stats(size_t cycle)
 {
-    return __mDest;
+    FlowPlan& plan = __mPlan;
+    Log::write("C", 1);
+    Log::write_varint(cycle + 1);
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        Flow& flow = __mFlows[f];
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            if(flow.nodes[k] == flow.src) {
+                continue;
+            }
+            FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+            for (size_t j = flow_node.in_begin; j < flow_node.in_end; ++j) {
+                size_t x = plan.in_edges[j];
+                Log::write_varint(__mPktsTransferred[x]);
+                Log::write_varint(__mTotalPktsTransferred[x]
+                        - __mLastEdgeTotals[x]);
+                __mLastEdgeTotals[x] = __mTotalPktsTransferred[x];
+            }
+        }
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            size_t m = flow.nodes[k];
+            size_t* last = &__mLastNodeCounters[3*m];
+            long long change = (long long)(__mPktsToBeSent[m] - last[2]);
+            Log::write_varint(__mTotalPktsRecv[m] - last[0]);
+            Log::write_varint(__mTotalPktsSent[m] - last[1]);
+            Log::write_varint(((size_t)change << 1) ^ (size_t)(change >> 63));
+            last[0] = __mTotalPktsRecv[m];
+            last[1] = __mTotalPktsSent[m];
+            last[2] = __mPktsToBeSent[m];
+        }
+    }
 }
 
-// Print all node statistics
-void Simulation::print_node_statistics()
+// Add the counters of the cycle to the window
+void Simulation::__update_window()
 {
-    Node* node;
-    std::set<NodeID>::iterator sIter;
-    for (sIter = __mNodeSet.begin(); sIter != __mNodeSet.end(); ++sIter) {
-        node = __mGraph->get_node_from_id(*sIter);
-        if(node == NULL){
-            continue;
+    if (__mWindowCycles == 0) {
+        __mWindowEdges.resize(3 * __mPktsTransferred.size());
+        __mWindowNodes.resize(3 * __mPktsToBeSent.size());
+        for (size_t x = 0; x < __mPktsTransferred.size(); ++x) {
+            size_t* window = &__mWindowEdges[3*x];
+            window[0] = window[1] = __mPktsTransferred[x];
+            window[2] = 0;
+        }
+        for (size_t m = 0; m < __mPktsToBeSent.size(); ++m) {
+            size_t* window = &__mWindowNodes[3*m];
+            window[0] = window[1] = __mPktsToBeSent[m];
+            window[2] = 0;
         }
-        node->print_statistics();
     }
+    ++__mWindowCycles;
 
+    for (size_t x = 0; x < __mPktsTransferred.size(); ++x) {
+        size_t* window = &__mWindowEdges[3*x];
+        window[0] = std::min(window[0], __mPktsTransferred[x]);
+        window[1] = std::max(window[1], __mPktsTransferred[x]);
+        window[2] += __mPktsTransferred[x];
+    }
+    for (size_t m = 0; m < __mPktsToBeSent.size(); ++m) {
+        size_t* window = &__mWindowNodes[3*m];
+        window[0] = std::min(window[0], __mPktsToBeSent[m]);
+        window[1] = std::max(window[1], __mPktsToBeSent[m]);
+        window[2] += __mPktsToBeSent[m];
+    }
 }
 
-void Simulation::reset_counters()
+// Print the min/avg/max of the window ending at the cycle
+void Simulation::__print_window(size_t cycle)
 {
-    std::set<NodeID>::iterator sIter;
-    for (sIter = __mNodeSet.begin(); sIter != __mNodeSet.end(); ++sIter) {
-        Node* node = __mGraph->get_node_from_id(*sIter);
-        if(node == NULL) {
-            continue;
+    FlowPlan& plan = __mPlan;
+    float count = __mWindowCycles;
+    Log::print_window_heading(cycle + 2 - __mWindowCycles, cycle + 1);
+
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        Flow& flow = __mFlows[f];
+        __print_flow_heading(flow);
+
+        Log::print_edge_window_heading();
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            if(flow.nodes[k] == flow.src) {
+                continue;
+            }
+            FlowNode& flow_node = plan.flow_nodes[flow.nodes[k]];
+            for (size_t j = flow_node.in_begin; j < flow_node.in_end; ++j) {
+                size_t x = plan.in_edges[j];
+                size_t e = plan.flow_edges[x];
+                size_t* window = &__mWindowEdges[3*x];
+                Log::print_edge_window(plan.node_ids[plan.edge_src[e]],
+                        plan.node_ids[plan.edge_dest[e]], plan.weights[e],
+                        window[0], window[2] / count, window[1],
+                        __mTotalPktsTransferred[x]);
+            }
+        }
+
+        Log::print_node_window_heading();
+        for (size_t k = 0; k < flow.nodes.size(); ++k) {
+            size_t m = flow.nodes[k];
+            size_t* window = &__mWindowNodes[3*m];
+            Log::print_node_window(plan.node_ids[plan.flow_nodes[m].node],
+                    __mTotalPktsRecv[m], __mTotalPktsSent[m],
+                    window[0], window[2] / count, window[1]);
         }
-        node->set_total_pkts_received(0);
-        node->set_total_pkts_sent(0);
-        node->set_no_pkts_to_be_sent(0);
-        node->reset_edge_counters();
     }
+    __mWindowCycles = 0;
 }
 
-// Start the data flow b/w src and dest for given number of cycle
-void Simulation::start(NodeID src, NodeID dest, size_t no_of_cylce)
+// Write the pkts sent and received of each flow (binary)
+void Simulation::__write_flow_stats()
 {
-    if(!update_src_and_dest(src, dest)){
+    Log::write("E", 1);
+    for (size_t f = 0; f < __mFlows.size(); ++f) {
+        Log::write_varint(__mTotalPktsSent[__mFlows[f].src]);
+        Log::write_varint(__mTotalPktsRecv[__mFlows[f].dest]);
+    }
+}
+
+// Look for the steady state of the flows after the cycle. The counters
+// repeat with period p (a multiple of the phase) from the cycle on
+// which the pkts to be sent of every flow node are the same as p cycles
+// before, or more at a flow node that had enough pkts to fill its edges
+// in each of those cycles: the pkts txed of every cycle are the same as
+// p cycles before and so they stay so.
+// The cycles whose pkts txed hash the same as p cycles before for p
+// cycles are the period to be verified on the next p cycles
+void Simulation::__detect_steady_state(size_t cycle)
+{
+    size_t done = cycle + 1;
+    if (__mPeriod) {
+        __save_state(done - __mPeriodStart);
+        if (done - __mPeriodStart < __mPeriod) {
+            return;
+        }
+        if (__is_steady()) {
+            __mSteadyCycles = done;
+            return;
+        }
+        __mPeriod = 0;
+        std::fill(__mRepeats.begin(), __mRepeats.end(), 0);
         return;
     }
 
-    for (int i = 0; i < no_of_cylce; ++i) {
-        //Print the header info
-        Log::print("\n\nCycle : ");
-        Log::print(Log::itos(i+1));
-        Log::print("\n============\n");
+    uint64_t hash = 0;
+    for (size_t w = 0; w < __mWorkers.size(); ++w) {
+        hash += __mWorkers[w].hash;
+    }
+    size_t ring = __mCycleHashes.size();
+    __mCycleHashes[cycle % ring] = hash;
+    for (size_t p = __mPhase; p <= STEADY_MAX_PERIOD; p += __mPhase) {
+        if ((cycle < p) || (__mCycleHashes[(cycle - p) % ring] != hash)) {
+            __mRepeats[p] = 0;
+            continue;
+        }
+        // Worth verifying only if it leaves cycles to be fast-forwarded
+        if ((++__mRepeats[p] >= p) && (done + 2 * p <= __mCycles) &&
+                ((p + 1) * __state_size() <= STEADY_MAX_STATE)) {
+            __mPeriod = p;
+            __mPeriodStart = done;
+            __mPeriodStates.resize((p + 1) * __state_size());
+            __save_state(0);
+            return;
+        }
+    }
+}
 
-        // Start to send the data b/w nodes (phase-1)
-        __start_arbitration();
+// Check the counters saved for the period
+bool Simulation::__is_steady()
+{
+    FlowPlan& plan = __mPlan;
+    size_t size = __state_size();
+    const size_t* first = __mPeriodStates.data() + 2 * plan.flow_edges.size();
+    const size_t* last = first + __mPeriod * size;
+    for (size_t m = 0; m < plan.flow_nodes.size(); ++m) {
+        if (last[m] < first[m]) {
+            return false;
+        }
+        if (last[m] == first[m]) {
+            continue;
+        }
+        size_t capacity = 0;
+        FlowNode& flow_node = plan.flow_nodes[m];
+        for (size_t x = flow_node.out_begin; x < flow_node.out_end; ++x) {
+            capacity += plan.weights[plan.flow_edges[x]];
+        }
+        for (size_t j = 0; j < __mPeriod; ++j) {
+            if (first[j * size + m] < capacity) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-        // Print the edge statistics heading
-        Log::print_edge_statistics_heading();
+// Counters in a state: pkts txed and total pkts txed by flow edge,
+// then pkts to be sent, total pkts recv and sent by flow node
+size_t Simulation::__state_size()
+{
+    return 2 * __mPlan.flow_edges.size() + 3 * __mPlan.flow_nodes.size();
+}
 
-        // Consume the data from nodes(phase-2)
-        __start_consumption();
+void Simulation::__save_state(size_t slot)
+{
+    size_t* state = __mPeriodStates.data() + slot * __state_size();
+    state = std::copy(__mPktsTransferred.begin(), __mPktsTransferred.end(), state);
+    state = std::copy(__mTotalPktsTransferred.begin(),
+            __mTotalPktsTransferred.end(), state);
+    state = std::copy(__mPktsToBeSent.begin(), __mPktsToBeSent.end(), state);
+    state = std::copy(__mTotalPktsRecv.begin(), __mTotalPktsRecv.end(), state);
+    std::copy(__mTotalPktsSent.begin(), __mTotalPktsSent.end(), state);
+}
 
-        // Print node statistics heading
-        Log::print_node_statistics_heading();
+// Set the counters after the given cycles of the steady state. They
+// are the counters of the cycle of the period saved plus the change
+// over the period for each period in b/w
+void Simulation::__load_state(size_t cycles)
+{
+    size_t size = __state_size();
+    size_t periods = (cycles - __mPeriodStart - 1) / __mPeriod;
+    size_t slot = cycles - __mPeriodStart - periods * __mPeriod;
+    const size_t* first = __mPeriodStates.data();
+    const size_t* last = first + __mPeriod * size;
+    const size_t* state = first + slot * size;
 
-        // Print all node statistics
-        print_node_statistics();
+    size_t edges = __mPktsTransferred.size();
+    size_t nodes = __mPktsToBeSent.size();
+    std::copy(state, state + edges, __mPktsTransferred.begin());
+    size_t k = edges;
+    for (size_t x = 0; x < edges; ++x, ++k) {
+        __mTotalPktsTransferred[x] = state[k] + periods * (last[k] - first[k]);
     }
-
-    // Print the flow rate b/w src and dest at end of flow
-    size_t pkt_sent = __mGraph->get_node_from_id(__mSrc)->get_total_pkts_sent();
-    size_t pkt_recv = __mGraph->get_node_from_id(__mDest)->get_total_pkts_received();
-    Log::print("\n\nFlow statistics:\n");
-    Log::print("================\n\n");
-    Log::print("Number of data sent from src\t:\t");
-    Log::print(Log::itos(pkt_sent));
-    Log::print("\n");
-    Log::print("Number of data received at dest\t:\t");
-    Log::print(Log::itos(pkt_recv));
-    Log::print("\n");
-    Log::print("Data flow rate from src to dest\t:\t");
-    if (pkt_sent){
-        Log::print(Log::ftos(((float)pkt_recv/(float)pkt_sent) * 100.00));
-        Log::print("%\n\n");
+    for (size_t m = 0; m < nodes; ++m, ++k) {
+        __mPktsToBeSent[m] = state[k] + periods * (last[k] - first[k]);
     }
-    else{
-        Log::print("0.0%\n\n");
+    for (size_t m = 0; m < nodes; ++m, ++k) {
+        __mTotalPktsRecv[m] = state[k] + periods * (last[k] - first[k]);
+    }
+    for (size_t m = 0; m < nodes; ++m, ++k) {
+        __mTotalPktsSent[m] = state[k] + periods * (last[k] - first[k]);
     }
+}
 
-    // Close the log
-    Log::close();
+// Run the cycles left after the steady state is found. Only the
+// counters of the cycles logged are set
+void Simulation::__fast_forward()
+{
+    size_t every = __mOptions.window ? 0 : __mOptions.every;
+    for (size_t cycle = __mSteadyCycles; cycle < __mCycles; ++cycle) {
+        if (every) {
+            cycle = std::min(((cycle + every) / every) * every - 1,
+                    __mCycles - 1);
+        }
+        __load_state(cycle + 1);
+        __print_cycle(cycle);
+    }
+    __load_state(__mCycles);
 }
 
-// Start arbitration b/w all nodes
-void Simulation::__start_arbitration()
+// Start arbitration b/w the active nodes of the worker
+void Simulation::__start_arbitration(size_t cycle, Worker& worker)
 {
-    Node* node;
-    std::set<NodeID>::iterator sIter;
+    // Data sent in last cycle is consumed already
+    for (size_t w = 0; w < worker.outbox.size(); ++w) {
+        worker.outbox[w].clear();
+    }
 
-    // Process each nodes one by one
-    for (sIter = __mNodeSet.begin(); sIter != __mNodeSet.end(); ++sIter) {
-        node = __mGraph->get_node_from_id(*sIter);
+    // Process each active nodes one by one
+    for (size_t k = 0; k < worker.active.size(); ++k) {
+        __arbitrate_node(worker.active[k], cycle, worker);
+    }
 
-        if(node == NULL){
-            continue;
+    // Hash of the pkts txed to look for steady state. Other nodes
+    // have no pkts txed
+    if (__mPhase) {
+        FlowPlan& plan = __mPlan;
+        uint64_t hash = 0;
+        for (size_t k = 0; k < worker.active.size(); ++k) {
+            size_t node = worker.active[k];
+            for (size_t m = plan.node_flow_offsets[node];
+                    m < plan.node_flow_offsets[node+1]; ++m) {
+                FlowNode& flow_node = plan.flow_nodes[m];
+                for (size_t x = flow_node.out_begin; x < flow_node.out_end; ++x) {
+                    if (__mPktsTransferred[x]) {
+                        hash += HashIndex::hash((x << 32) ^ __mPktsTransferred[x]);
+                    }
+                }
+            }
         }
+        worker.hash = hash;
+    }
+}
+
+// Arbitrate the data of all flows at the node. The flows share the
+// capacity of the out edges; the flow served first changes every
+// cycle so that no flow is starved
+void Simulation::__arbitrate_node(size_t node, size_t cycle,
+        Worker& worker)
+{
+    FlowPlan& plan = __mPlan;
+    size_t first = plan.node_flow_offsets[node];
+    size_t count = plan.node_flow_offsets[node+1] - first;
+    STATS_ADD(worker.stats.nodes_arbitrated, 1);
+
+    // Nothing is transferred yet in this cycle
+    for (size_t e = plan.out_offsets[node]; e < plan.out_offsets[node+1]; ++e) {
+        __mEdgeUsed[e] = 0;
+    }
+    for (size_t m = first; m < first + count; ++m) {
+        FlowNode& flow_node = plan.flow_nodes[m];
+        for (size_t x = flow_node.out_begin; x < flow_node.out_end; ++x) {
+            __mPktsTransferred[x] = 0;
+        }
+        STATS_ADD(worker.stats.edges_visited,
+                flow_node.out_end - flow_node.out_begin);
+    }
+
+    for (size_t r = 0; r < count; ++r) {
+        size_t m = first + (cycle + r) % count;
 
         // Get the number of pkts to be sent. If it is zero
         // no need to distribute data
-        size_t no_pkt_tbs = node->get_no_pkts_to_be_sent();
+        size_t no_pkt_tbs = __mPktsToBeSent[m];
 
         // Destination node will be excluded as it only receives the data
-        if((no_pkt_tbs > 0)  && (*sIter != __mDest)) {
-            __distribute_data(node, no_pkt_tbs);
+        if((no_pkt_tbs > 0)  && (m != __mFlows[plan.flow_nodes[m].flow].dest)) {
+            __distribute_data(m, no_pkt_tbs, worker);
         }
     }
 }
 
 // Main function to distribute the data b/w all nodes
-void Simulation::__distribute_data(Node* node, size_t no_pkt_tbs)
-{
-    EdgeList out_list = node->get_out_edge_list();
-
-    // Filtered-out the nodes that are not involving in the
-    // data flow and stores remaining
-    EdgeList filtered_out_list;
-    size_t out_capacity = 0;
-    size_t actual_pkt_tbs = no_pkt_tbs;
+void Simulation::__distribute_data(size_t flow_node, size_t no_pkt_tbs,
+        Worker& worker)
+{
+    // Out edges of the node that are involved in the data flow
+    FlowPlan& plan = __mPlan;
+    size_t first = plan.flow_nodes[flow_node].out_begin;
+    size_t out_edge_cout = plan.flow_nodes[flow_node].out_end - first;
+    const size_t* edges = plan.flow_edges.data() + first;
+    size_t* transferred = __mPktsTransferred.data() + first;
+    size_t* total_transferred = __mTotalPktsTransferred.data() + first;
+
+    STATS_ADD(worker.stats.distribute_loops, out_edge_cout);
+
+    // Capacity left by the other flows
+    for(size_t k = 0; k < out_edge_cout; ++k) {
+        worker.residual[k] = plan.weights[edges[k]] - __mEdgeUsed[edges[k]];
+    }
 
-    for(int i = 0; i < out_list.size(); ++i) {
-        if(__mNodeSet.count(out_list[i]->get_destination_node()->getId())) {
-            out_capacity += out_list[i]->get_weight();
-            out_list[i]->set_no_of_pkts_transferred(0);
-            filtered_out_list.push_back(out_list[i]);
+    // Divide pockets and send equally across all edges
+    size_t pkt_sent = equal_split(worker.residual.data(), out_edge_cout,
+            no_pkt_tbs, transferred, worker.scratch.data());
+
+    for(size_t k = 0; k < out_edge_cout; ++k) {
+        __mEdgeUsed[edges[k]] += transferred[k];
+        total_transferred[k] += transferred[k];
+        // Destination is to consume the data
+        if (transferred[k]) {
+            size_t dest = plan.edge_dest[edges[k]];
+            worker.outbox[__mNodeWorker[dest]].push_back(dest);
         }
     }
 
-    size_t out_edge_cout = filtered_out_list.size();
-
-    while(no_pkt_tbs && out_capacity) {
-        // Divide pockets and send equally across all edges
-        // divide the total pockets to send across all
-        // out edges
-        size_t pkt_divide = no_pkt_tbs/out_edge_cout;
-        for(int k = 0; k < out_edge_cout; ++k) {
-
-            // if the no of pkts to be sent is less the number
-            // of edge count, then send 1 pkt to all nodes until
-            // pkt is available (some edge won't get pkt in this case)
-            if(pkt_divide == 0) {
-                pkt_divide = 1;
-            }
-
-            size_t weight = filtered_out_list[k]->get_weight();
-            size_t pkt_transferred = filtered_out_list[k]->get_no_of_pkts_transferred();
-            size_t current_weight = weight - pkt_transferred;
+    // Update total number of pkts sent count
+    __mTotalPktsSent[flow_node] += pkt_sent;
 
-            if(current_weight > pkt_divide){
-                pkt_transferred += pkt_divide;
-                filtered_out_list[k]->set_no_of_pkts_transferred(pkt_transferred);
+    // Update the no of pkt to be sent if any remaining
+    // so that will be processed in next cycle.
+    // This is not applicable for source as it has infinte pkt to be sent
+    if (flow_node != __mFlows[plan.flow_nodes[flow_node].flow].src) {
+        __mPktsToBeSent[flow_node] = no_pkt_tbs - pkt_sent;
+    }
+}
 
-                // Update total pkts transferred
-                size_t total_pkts_transferred =
-                    filtered_out_list[k]->get_total_pkts_transferred();
-                total_pkts_transferred += pkt_divide;
-                filtered_out_list[k]->set_total_pkts_transferred(total_pkts_transferred);
+// Divide no_pkt_tbs pkts equally across edges of given capacity and
+// store the pkts of each edge in pkts. Returns the pkts sent.
+//
+// This is the closed form of sending pkt_divide (no_pkt_tbs / count,
+// at least 1) pkts to each edge in rounds until the pkts or the
+// capacity is exhausted: every edge is filled up to a common level
+// and the pkts left below the next level go one per edge, in edge
+// order, to the edges that still have capacity.
+// scratch must have room for count weights.
+size_t Simulation::equal_split(const EdgeWeight* capacity, size_t count,
+        size_t no_pkt_tbs, size_t* pkts, EdgeWeight* scratch)
+{
+    size_t out_capacity = 0;
+    for(size_t k = 0; k < count; ++k) {
+        out_capacity += capacity[k];
+    }
 
-                // Decrment the no of pkts to be sent and out capacity
-                no_pkt_tbs -= pkt_divide;
-                out_capacity -= pkt_divide;
-            }
-            else {
-                pkt_transferred += current_weight;
-                filtered_out_list[k]->set_no_of_pkts_transferred(pkt_transferred);
+    // Enough pkts to fill all edges
+    if(no_pkt_tbs >= out_capacity) {
+        for(size_t k = 0; k < count; ++k) {
+            pkts[k] = capacity[k];
+        }
+        return out_capacity;
+    }
 
-                // Update total pkts transferred
-                size_t total_pkts_transferred =
-                    filtered_out_list[k]->get_total_pkts_transferred();
-                total_pkts_transferred += current_weight;
-                filtered_out_list[k]->set_total_pkts_transferred(total_pkts_transferred);
+    // Find the fill level: edges below the level are full and the
+    // pkts left are shared by the edges above it
+    std::copy(capacity, capacity + count, scratch);
+    std::sort(scratch, scratch + count);
+
+    size_t level = 0;
+    size_t filled = 0;      // pkts taken by full edges
+    for(size_t j = 0; j < count; ++j) {
+        size_t above = count - j;
+        if(filled + above * scratch[j] > no_pkt_tbs) {
+            level = (no_pkt_tbs - filled) / above;
+            break;
+        }
+        filled += scratch[j];
+    }
 
-                // Decrment the no of pkts to be sent and out capacity
-                no_pkt_tbs -= current_weight;
-                out_capacity -=  current_weight;
-            }
+    size_t remaining = no_pkt_tbs;
+    for(size_t k = 0; k < count; ++k) {
+        pkts[k] = (capacity[k] < level) ? capacity[k] : level;
+        remaining -= pkts[k];
+    }
 
-            if((!no_pkt_tbs) || (!out_capacity)) {
-                break;
+    // Left over pkts (less than edges above level) one per edge
+    for(size_t k = 0; (k < count) && remaining; ++k) {
+        if(capacity[k] > level) {
+            ++pkts[k];
+            --remaining;
+        }
+    }
+    return no_pkt_tbs - remaining;
+}
+
+// Consume the data sent to the nodes of the worker (phase-2) and
+// find the nodes active in next cycle
+void Simulation::__start_consumption(size_t cycle, size_t w)
+{
+    Worker& worker = __mWorkers[w];
+    std::vector<size_t>& next = worker.next;
+    next.clear();
+    for (size_t v = 0; v < __mWorkers.size(); ++v) {
+        std::vector<size_t>& sent = __mWorkers[v].outbox[w];
+        for (size_t k = 0; k < sent.size(); ++k) {
+            size_t node = sent[k];
+            if (__mConsumedAt[node] != cycle + 1) {
+                __mConsumedAt[node] = cycle + 1;
+                __consume_node(node);
+                STATS_ADD(worker.stats.nodes_consumed, 1);
+                next.push_back(node);
             }
         }
     }
 
-    // Update total number of pkts sent count
-    size_t total_pkt_sent = node->get_total_pkts_sent();
-    total_pkt_sent += (actual_pkt_tbs - no_pkt_tbs);
-    node->set_total_pkts_sent(total_pkt_sent);
-
-    // Update the no of pkt to be sent if any remaining
-    // so that will be processed in next cycle.
-    // This is not applicable for source as it has infinte pkt to be sent
-    if (node->getId() != __mSrc) {
-        node->set_no_pkts_to_be_sent(no_pkt_tbs);
+    // Nodes consumed or arbitrated that are still active
+    size_t count = 0;
+    for (size_t k = 0; k < next.size(); ++k) {
+        if (__is_active(next[k])) {
+            __mActiveAt[next[k]] = cycle + 1;
+            next[count++] = next[k];
+        }
+    }
+    next.resize(count);
+    for (size_t k = 0; k < worker.active.size(); ++k) {
+        size_t node = worker.active[k];
+        if ((__mActiveAt[node] != cycle + 1) && __is_active(node)) {
+            __mActiveAt[node] = cycle + 1;
+            next.push_back(node);
+        }
     }
+    worker.active.swap(next);
 }
 
-// Consume the data (phase-2)
-void Simulation::__start_consumption()
+// A node is to be arbitrated if any flow has pkts to be sent at it or
+// had pkts txed from it, which are to be cleared
+bool Simulation::__is_active(size_t node)
 {
-    Node* node;
-    std::set<NodeID>::iterator sIter;
-
-    // Process each nodes one by one
-    for (sIter = __mNodeSet.begin(); sIter != __mNodeSet.end(); ++sIter) {
-        node = __mGraph->get_node_from_id(*sIter);
-        if(node == NULL){
-            continue;
+    FlowPlan& plan = __mPlan;
+    for (size_t m = plan.node_flow_offsets[node];
+            m < plan.node_flow_offsets[node+1]; ++m) {
+        FlowNode& flow_node = plan.flow_nodes[m];
+        if (__mPktsToBeSent[m] && (m != __mFlows[flow_node.flow].dest)) {
+            return true;
         }
-        // Destination node will be excluded as it only receives the data
-        if((*sIter != __mSrc)) {
-            __consume_data(node);
+        for (size_t x = flow_node.out_begin; x < flow_node.out_end; ++x) {
+            if (__mPktsTransferred[x]) {
+                return true;
+            }
         }
     }
+    return false;
 }
 
-void Simulation::__consume_data(Node* node)
+// Consume the data of all flows at the node
+void Simulation::__consume_node(size_t node)
 {
-    EdgeList in_list = node->get_in_edge_list();
-
-    // Filtered-out the nodes that are not involving in the
-    // data flow and stores remaining
-    EdgeList filtered_in_list;
-
-    for(int i = 0; i < in_list.size(); ++i) {
-        if(__mNodeSet.count(in_list[i]->get_destination_node()->getId())) {
-            filtered_in_list.push_back(in_list[i]);
+    FlowPlan& plan = __mPlan;
+    for (size_t m = plan.node_flow_offsets[node];
+            m < plan.node_flow_offsets[node+1]; ++m) {
+        // Source node will be excluded as it only sends the data
+        if(m != __mFlows[plan.flow_nodes[m].flow].src) {
+            __consume_data(m);
         }
     }
+}
 
+void Simulation::__consume_data(size_t flow_node)
+{
+    FlowPlan& plan = __mPlan;
+    FlowNode& node = plan.flow_nodes[flow_node];
     size_t pkt_received = 0;
-    for(int k = 0; k < filtered_in_list.size(); ++k) {
-        pkt_received += filtered_in_list[k]->get_no_of_pkts_transferred();
-        filtered_in_list[k]->print_statistics();
-        filtered_in_list[k]->set_no_of_pkts_transferred(0);
+    for(size_t k = node.in_begin; k < node.in_end; ++k) {
+        pkt_received += __mPktsTransferred[plan.in_edges[k]];
     }
     // Update total number of pkts received count
-    size_t total_pkt_received = node->get_total_pkts_received();
-    total_pkt_received += pkt_received;
-    node->set_total_pkts_received(total_pkt_received);
+    __mTotalPktsRecv[flow_node] += pkt_received;
 
     // Update the no of pkt to be sent
-    if (node->getId() != __mDest) {
-        size_t no_pkt_tbs = node->get_no_pkts_to_be_sent();
-        no_pkt_tbs += pkt_received;
-        node->set_no_pkts_to_be_sent(no_pkt_tbs);
+    if (flow_node != __mFlows[node.flow].dest) {
+        __mPktsToBeSent[flow_node] += pkt_received;
     }
 }
-
@@ -8,10 +8,32 @@
 # include <vector>
 # include <set>
 # include <map>
+# include <memory_resource>
+# include <deque>
+# include <queue>
+# include <functional>
+# include <tuple>
 # include <string>
 # include <time.h>
 # include <algorithm>
-
+# include <numeric>
+# include <cmath>
+# include <charconv>
+# include <cstring>
+# include <cstdio>
+# include <cstdint>
+# include <thread>
+# include <chrono>
+# include <mutex>
+# include <condition_variable>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+
+// Pkts of the source. It replaces the float INFINITY of <cmath>, which
+// is included first so that a later include does not bring it back
+# undef INFINITY
 # define INFINITY (unsigned int)-1
 
 typedef unsigned int EdgeWeight;
@@ -21,112 +43,167 @@ typedef unsigned int NodeID;
 // Node type (in node, out node, or both)
 typedef enum {OUT, IN, ALL} ADJNODETYPE;
 
+// Format of the flow statistics (text tables or binary)
+typedef enum {STATS_TEXT, STATS_BINARY} STATSFORMAT;
+
+// Order of the paths listed (depth first, fewest edges or least weight)
+typedef enum {PATHS_DFS, PATHS_HOPS, PATHS_WEIGHT} PATHORDER;
+
+// Binary statistics file (see graph_stats_render). Numbers are unsigned
+// LEB128 varints:
+//   STATS_MAGIC, text printed before the cycles, '\0'
+//   no of flows, then for each flow: src, dest,
+//       no of edge rows, (src, dest, weight) of each,
+//       no of node rows, id of each
+//   'C' and cycle no for each cycle written, then for each flow:
+//       for each edge row pkts txed and the change of total pkts txed,
+//       for each node row the change of total pkts received and sent
+//       and the zigzag encoded change of pkts remaining
+//   (changes are from the last cycle written)
+//   'E', then pkts sent and received of each flow
+# define STATS_MAGIC "GSTATS02"
+# define STATS_MAGIC_SIZE 8
+
+// Instrumentation of the simulation, built with make STATS=yes.
+// Without it the timers and counters are compiled out
+# ifdef SIMULATION_STATS
+# define STATS_TIMER(name) \
+    std::chrono::steady_clock::time_point name = std::chrono::steady_clock::now()
+# define STATS_ELAPSED(counter, since) \
+    ((counter) += std::chrono::duration_cast<std::chrono::nanoseconds>( \
+            std::chrono::steady_clock::now() - (since)).count())
+# define STATS_ADD(counter, n) ((counter) += (n))
+# else
+# define STATS_TIMER(name)
+# define STATS_ELAPSED(counter, since)
+# define STATS_ADD(counter, n)
+# endif
+
+# define LOG_BUFFER_SIZE (1 << 20)   // Size of log buffer to be written
+# define LOG_BUFFERS 4                // No of buffers queued to writer
+
 // Base class to have log file and format attributes
+// The logs printed are kept in a buffer of the printing thread. Full
+// buffers are written to the file by a writer thread, so printing
+// does not wait for the file unless LOG_BUFFERS are already queued.
+// close() writes all pending logs of the calling thread
 class Log
 {
     protected:
-        static std::ofstream _mCout;  // out stream
+        static std::ofstream _mCout;  // out stream (used by writer)
         static size_t _mTotalWidth;   // Maximum width
         static char _mDelimiter;      // Delimiter for table columns
 
+    private:
+        static thread_local std::string __mBuffer;  // Logs of this thread
+        static std::deque<std::string> __mQueue;    // Buffers to be written
+        static std::vector<std::string> __mFree;    // Buffers written
+        static std::mutex __mMutex;
+        static std::condition_variable __mQueued;   // Buffer queued
+        static std::condition_variable __mWritten;  // Buffer written
+        static std::thread __mWriter;               // Writer thread
+        static bool __mStop;                        // Writer to be stopped
+        static uint64_t __mWriteTime;               // ns in writing file
+
     public:
         Log() {}
         ~Log(){ }
 
         static bool open(std::string& file);
         static void close();
+        // Hand over the logs of this thread to the writer
+        static void flush();
+        // Time spent by the writer in writing files so far (ns)
+        static uint64_t get_write_time();
         static std::string center(const std::string str, int width);
         static std::string ftos(float n);
         static std::string itos(size_t n);
         static void print(const std::string& str);
         static void print_node_statistics_heading();
         static void print_edge_statistics_heading();
-};
-
-// Class for edge simulation properties
-// Base class for Edge
-class EdgeSimualtionProperty : public virtual Log
-{
-    protected:
-        size_t _mNoOfPktsTransferred ;   // No of pkts transferred in current cycle
-        size_t _mTotalPktsTransferred ;   // No of pkts transferred in current cycle
+        // Print one row of the edge/node statistics table
+        static void print_edge_statistics(NodeID src, NodeID dest,
+                EdgeWeight weight, size_t pkts_txed, size_t total_pkts_txed);
+        static void print_node_statistics(NodeID id, size_t total_pkts_recv,
+                size_t total_pkts_sent, size_t pkts_remaining);
+        static void print_cycle_heading(size_t cycle);
+        // Tables of min/avg/max over a window of cycles
+        static void print_window_heading(size_t first, size_t last);
+        static void print_edge_window_heading();
+        static void print_node_window_heading();
+        static void print_edge_window(NodeID src, NodeID dest,
+                EdgeWeight weight, size_t min_pkts_txed, float avg_pkts_txed,
+                size_t max_pkts_txed, size_t total_pkts_txed);
+        static void print_node_window(NodeID id, size_t total_pkts_recv,
+                size_t total_pkts_sent, size_t min_pkts_remaining,
+                float avg_pkts_remaining, size_t max_pkts_remaining);
+        static void print_flow_heading(NodeID src, NodeID dest);
+        static void print_flow_statistics_heading();
+        static void print_flow_statistics(NodeID src, NodeID dest,
+                size_t pkts_sent, size_t pkts_recv, bool heading);
+        static void print_max_flow_ratio(size_t max_flow, size_t pkts_recv,
+                size_t cycles);
+        // Write binary statistics
+        static void write(const char* data, size_t len);
+        static void write_varint(size_t n);
 
-    public:
-        EdgeSimualtionProperty(EdgeCapacity capacity)
-            :
-                Log(),
-                _mNoOfPktsTransferred(0),
-                _mTotalPktsTransferred(0)
-        { }
-        virtual ~EdgeSimualtionProperty() {}
-
-        size_t get_no_of_pkts_transferred();
-        void set_no_of_pkts_transferred(size_t value);
-        void increment_no_of_pkts_transferred();
-        void decrement_no_of_pkts_transferred();
-
-        size_t get_total_pkts_transferred();
-        void set_total_pkts_transferred(size_t value);
-        void increment_total_pkts_transferred();
-
-        friend std::ofstream& operator<<(std::ofstream&,
-                const EdgeSimualtionProperty&);
+    private:
+        static void __write_buffers();
+        static void __append(const char* str, size_t len);
+        // Table formatting without allocation
+        static char* __put_uint(char* p, size_t n);
+        static char* __put_center(char* p, const char* str, size_t len,
+                size_t width);
+        static char* __put_center(char* p, size_t n, size_t width);
+        static char* __put_float_center(char* p, float n, size_t width);
+        static std::string __table_heading(const std::string& title,
+                const char** columns, const size_t* widths, size_t count);
 };
 
-// Class for node simulation properties
-// Base class for Node
-class NodeSimualtionProperty : public virtual Log
+// Statistics of the last simulation of a graph, summed over its flows.
+// The counters are kept by dense index of node and edge, so the nodes
+// and edges carry no counters
+struct GraphCounters
 {
-    protected:   // Node statistics
-        size_t _mNoOfPktToBeSent;
-        size_t _mTotalNoOfPktRecv;
-        size_t _mTotalNoOfPktSent;
-
-    public:
-        NodeSimualtionProperty(): Log()
-        {
-            _mNoOfPktToBeSent = 0;
-            _mTotalNoOfPktSent = 0;
-            _mTotalNoOfPktRecv = 0;
-        }
-        virtual ~NodeSimualtionProperty(){}
-
-        size_t get_no_pkts_to_be_sent();
-        void set_no_pkts_to_be_sent(size_t count);
-        void increment_no_pkts_to_be_sent();
-        void decrement_no_pkts_to_be_sent();
-
-        size_t get_total_pkts_sent();
-        void set_total_pkts_sent(size_t count);
-        void increment_total_pkts_sent();
-
-        size_t get_total_pkts_received();
-        void set_total_pkts_received(size_t count);
-        void increment_total_pkts_received();
-        friend std::ofstream& operator<<(std::ofstream&,
-                const NodeSimualtionProperty&);
+    std::vector<size_t> pkts_transferred;        // By edge, in last cycle
+    std::vector<size_t> total_pkts_transferred;  // By edge
+    std::vector<size_t> pkts_to_be_sent;         // By node
+    std::vector<size_t> total_pkts_recv;         // By node
+    std::vector<size_t> total_pkts_sent;         // By node
+
+    void reset(size_t nodes, size_t edges);
+    void clear_node(size_t index);
+    void clear_edge(size_t index);
 };
 
 // Forward declaration.
 class Node;
 
-class Edge : virtual public EdgeSimualtionProperty
+class Edge
 {
+    friend class Node;
+
     private:
         EdgeWeight __mWeight;      // Weight
         Node* __mSrc;              // Source
         Node* __mDest;             // Destination
+        size_t __mIndex;           // Dense index assigned by graph
+        uint32_t __mOutPos;        // Position in out edge list of source
+        uint32_t __mInPos;         // Position in in edge list of dest
 
     public:
-        Edge(EdgeWeight weight, Node* src, Node* dest)
+        Edge(EdgeWeight weight, Node* src, Node* dest, size_t index = 0)
             :
-                EdgeSimualtionProperty(weight),
                 __mWeight(weight),
                 __mSrc(src),
-                __mDest(dest)
+                __mDest(dest),
+                __mIndex(index),
+                __mOutPos(0),
+                __mInPos(0)
         { }
         ~Edge() {}
 
+        size_t get_index();
         Node* get_source_node();
         Node* get_destination_node();
         void set_weight(EdgeWeight new_weight);
@@ -134,36 +211,52 @@ class Edge : virtual public EdgeSimualtionProperty
         bool is_node_src(Node* src);
         bool is_node_dest(Node* dest);
         bool is_having_node(Node *node);
-        void print_statistics();
 };
 
 typedef std::vector<NodeID> NodeIDList;
-typedef std::vector<Edge*> EdgeList;
+// Edge lists of the nodes are allocated from the pool of the graph
+typedef std::pmr::vector<Edge*> EdgeList;
 
-class Node : virtual public NodeSimualtionProperty
+class Node
 {
     private:
         NodeID __mId;           // Node id
+        size_t __mIndex;        // Dense index assigned by graph
         EdgeList __mInEdges;    // Incoming edges list
         EdgeList __mOutEdges;   // Outgoing edges list
+        // Removed edges are left as NULL in the lists till the lists
+        // are used, so that removing is O(1)
+        size_t __mInHoles;      // No of NULL in incoming edges list
+        size_t __mOutHoles;     // No of NULL in outgoing edges list
         bool __mVisited;        // for traversal
 
     public:
-        Node(NodeID node_id)
+        Node(NodeID node_id, size_t index = 0,
+                std::pmr::memory_resource* pool =
+                std::pmr::get_default_resource())
             :
-                NodeSimualtionProperty(),
                 __mId(node_id),
+                __mIndex(index),
+                __mInEdges(pool),
+                __mOutEdges(pool),
+                __mInHoles(0),
+                __mOutHoles(0),
                 __mVisited(false)
         { }
         ~Node(){}
 
         NodeID& getId();
+        size_t get_index();
 
         void set_visited(bool visited_flag);
         bool is_visited();
 
         void add_incoming_edge(Edge* in_edge);
         void add_outgoing_edge(Edge* out_edge);
+        void reserve_edges(size_t in_edges, size_t out_edges);
+        // Remove the edge from the list in O(1)
+        void remove_incoming_edge(Edge* in_edge);
+        void remove_outgoing_edge(Edge* out_edge);
 
         void remove_edge_with_node(Node& anode, ADJNODETYPE type);
         void unlink_all_edges();
@@ -175,34 +268,164 @@ class Node : virtual public NodeSimualtionProperty
         // Summation of outgoing and incoming edges capacity
         size_t get_out_edges_capacity();
         size_t get_in_edges_capacity();
-        EdgeList get_out_edge_list();
-        EdgeList get_in_edge_list();
-        void print_statistics();
-        void reset_edge_counters();
+        const EdgeList& get_out_edge_list();
+        const EdgeList& get_in_edge_list();
+
+    private:
+        void __compact();
+};
+
+// Edge read from a graph file
+struct EdgeEntry
+{
+    NodeID src;
+    NodeID dest;
+    EdgeWeight weight;
+};
+
+# define SLAB_CHUNK_SIZE (1 << 16)   // Slots in a chunk of slab
+
+// Slab of objects of T, for at most max objects. The slots are in
+// chunks of SLAB_CHUNK_SIZE, allocated when needed, and the slots of
+// freed objects are reused. Slot is the dense index of the object.
+// Destroying the slab releases the chunks without destroying the
+// objects left
+template <typename T>
+class Slab
+{
+    private:
+        std::vector<T*> __mChunks;      // Chunks of slots
+        std::vector<size_t> __mFree;    // Slots of freed objects
+        size_t __mMax;                  // Max. No of objects
+        size_t __mBound;                // Slots used so far
+        size_t __mCount;                // No of objects
+
+    public:
+        Slab(size_t max)
+            :
+                __mMax(max),
+                __mBound(0),
+                __mCount(0)
+        { }
+        ~Slab()
+        {
+            for (size_t c = 0; c < __mChunks.size(); ++c) {
+                ::operator delete(__mChunks[c]);
+            }
+        }
+
+        size_t size() const { return __mCount; }
+        size_t bound() const { return __mBound; }
+        size_t available() const { return __mMax - __mCount; }
+
+        // Slot for new object, to be constructed at get(slot).
+        // available() must be checked first
+        size_t allocate()
+        {
+            ++__mCount;
+            if (__mFree.size()) {
+                size_t slot = __mFree.back();
+                __mFree.pop_back();
+                return slot;
+            }
+            if (__mBound == __mChunks.size() * SLAB_CHUNK_SIZE) {
+                size_t slots = std::min((size_t)SLAB_CHUNK_SIZE,
+                        __mMax - __mBound);
+                __mChunks.push_back(
+                        (T*)::operator new(slots * sizeof(T)));
+            }
+            return __mBound++;
+        }
+        // Destroy the object and free its slot
+        void free(size_t slot)
+        {
+            get(slot)->~T();
+            __mFree.push_back(slot);
+            --__mCount;
+        }
+        T* get(size_t slot)
+        {
+            return __mChunks[slot / SLAB_CHUNK_SIZE] + slot % SLAB_CHUNK_SIZE;
+        }
+
+    private:
+        Slab(const Slab&);
+        Slab& operator=(const Slab&);
+};
+
+// Hash table of 64-bit keys to values, by open addressing with
+// linear probing. A key is erased by shifting back the keys after
+// it, so that lookups never pass deleted keys. Key -1 is reserved
+class HashIndex
+{
+    private:
+        struct Slot
+        {
+            uint64_t key;
+            uint64_t value;
+        };
+        std::vector<Slot> __mSlots;
+        size_t __mCount;        // No of keys
+
+    public:
+        static const uint64_t NONE = (uint64_t)-1;
+
+        HashIndex() : __mCount(0) { }
+
+        size_t size() const { return __mCount; }
+        // Value of the key, NONE if not exists
+        uint64_t find(uint64_t key) const;
+        // Add the key or update its value
+        void insert(uint64_t key, uint64_t value);
+        void erase(uint64_t key);
+        // Make room for count keys
+        void reserve(size_t count);
+        // Keys and their values, in no particular order
+        void get_entries(
+                std::vector<std::pair<uint64_t, uint64_t> >& entries) const;
+        // Mix the bits of key
+        static uint64_t hash(uint64_t key);
+
+    private:
+        void __rehash(size_t size);
 };
 
-typedef std::map<NodeID, Node*> NodeList;  // <Node_id, Node> pair
-typedef std::map<NodeID, Node*>::iterator NodeListIter;
 typedef std::vector<NodeID> Path;
 
+class GraphImage;
+
 class Graph
 {
+    friend class GraphImage;
+
     private:
-        NodeList __mNodes;                 // map of node id with node
-        size_t __mMaxNodes;                // Max. No of Nodes
-        size_t __mMaxEdges;                // Max. No of Edges
+        // Nodes and edges are in slabs sized by max. no of nodes and
+        // edges, and their edge lists in the pool. The graph is
+        // deleted by releasing them, without deleting each object
+        std::pmr::unsynchronized_pool_resource __mPool;
+        Slab<Node> __mNodeSlab;
+        Slab<Edge> __mEdgeSlab;
+        HashIndex __mNodeIndex;            // Node of node id index
+        HashIndex __mEdgeIndex;            // Edge of (src, dest) index
+        GraphCounters __mCounters;         // Of last simulation
+        GraphImage* __mImage;              // Frozen form (see freeze)
+        bool __mChanged;                   // Changed since last freeze
 
     public:
         Graph(size_t maxnode=0,
                 size_t maxedge=0)
             :
-                __mMaxNodes(maxnode),
-                __mMaxEdges(maxedge)
+                __mNodeSlab(maxnode),
+                __mEdgeSlab(maxedge),
+                __mImage(NULL),
+                __mChanged(true)
         { }
-        ~Graph(){}
+        ~Graph();
 
         void add_edge(NodeID src_id, NodeID dest_id, EdgeWeight weight);
         bool add_node(NodeID node_id);
+        // Add all edges of an edge list or DIMACS file
+        bool load_edges(const char* file);
 
         void delete_edge(Node& src_node, Node& dest_node);
         void delete_edge(NodeID src_id, NodeID dest_id);
@@ -212,53 +435,545 @@ class Graph
         void delete_node(NodeID node_id);
 
         Node* get_node_from_id(NodeID node_id);  // Get node from id
-
-        std::vector<Path> get_paths(NodeID src_id, NodeID dest_id);
-        std::vector<Path> get_paths(Node& src_node, Node& dest_node);
+        Edge* get_edge(Node& src_node, Node& dest_node);  // O(1)
+        size_t get_node_index_bound();           // Upper bound of node index
+        size_t get_edge_index_bound();           // Upper bound of edge index
+        GraphCounters& get_counters();
+        // Read-only image of the graph in compressed sparse row form.
+        // It is built again only if the graph is changed since last
+        // freeze, and stays at the same address
+        GraphImage& freeze();
+        void print_statistics(Node& node);
+        void print_statistics(Edge& edge);
+
+        // List the simple paths b/w src and dest. At most max_paths
+        // paths are listed (0 for no limit). PathIterator lists them
+        // one at a time
+        std::vector<Path> get_paths(NodeID src_id, NodeID dest_id,
+                size_t max_paths = 0);
+        std::vector<Path> get_paths(Node& src_node, Node& dest_node,
+                size_t max_paths = 0);
+
+        // Nodes that are reachable from src and can reach dest
+        // (ascending order of node id)
+        NodeIDList get_involved_nodes(NodeID src_id, NodeID dest_id);
+        NodeIDList get_adjency_list(NodeID node_id, ADJNODETYPE type);
 
         void reset_traversal();
 
     private:
-        void __form_path(Node& src, Node& dest,
-                std::vector<Path>& nPathList,
-                Path& nPath);
+        Node* __new_node(NodeID node_id);
+        Edge* __new_edge(EdgeWeight weight, Node* src, Node* dest);
+        void __free_edge(Edge* edge);
+        static uint64_t __edge_key(Node& src_node, Node& dest_node);
+        static const char* __parse_edges(const char* begin, const char* end,
+                std::vector<EdgeEntry>& edges);
+};
+
+# define GRAPH_IMAGE_MAGIC "GRAPHIMG"
+# define GRAPH_IMAGE_MAGIC_SIZE 8
+# define GRAPH_IMAGE_VERSION 1
+
+// Header of graph image file (see save_graph). It is followed by the
+// arrays below, each starting at a multiple of 8 bytes:
+//   node ids      uint32 by node (ascending)
+//   out offsets   uint64 by node + 1
+//   in offsets    uint64 by node + 1
+//   in edges      uint64 by in edge (edge index)
+//   edge src      uint32 by edge (node index)
+//   edge dest     uint32 by edge (node index)
+//   weights       uint32 by edge
+// Numbers are in native byte order. Only indices are stored, so the
+// image can be mapped at any address
+struct GraphImageHeader
+{
+    char magic[GRAPH_IMAGE_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t node_count;
+    uint64_t edge_count;
+    uint64_t size;          // Size of the image in bytes
+};
+
+// Unsigned integer of any size, for the no of paths b/w two nodes
+// which can be far beyond 64 bits
+class PathCount
+{
+    private:
+        std::vector<uint32_t> __mDigits;    // Base 2^32, lowest first
+
+    public:
+        PathCount(uint64_t n = 0);
+        PathCount& operator+=(const PathCount& other);
+        bool is_zero() const { return __mDigits.empty(); }
+        std::string to_string() const;
+};
+
+// Read-only graph in compressed sparse row form. Nodes are numbered
+// in ascending node id order and edges in out edge order of their
+// source, so the out edges of node i are [out_begin(i), out_end(i)).
+// The in edges of node i are in_edge(k) for k in [in_begin(i), in_end(i))
+// in order of in edge list. The image is either built from a graph,
+// keeping its node and edge objects, or mapped from a file
+class GraphImage
+{
+    friend class PathIterator;
+
+    private:
+        std::vector<uint64_t> __mData;      // Image built from graph
+        void* __mMap;                       // Image mapped from file
+        size_t __mMapSize;
+        const GraphImageHeader* __mHeader;
+        const NodeID* __mNodeIds;
+        const uint64_t* __mOutOffsets;
+        const uint64_t* __mInOffsets;
+        const uint64_t* __mInEdges;
+        const uint32_t* __mEdgeSrc;
+        const uint32_t* __mEdgeDest;
+        const EdgeWeight* __mWeights;
+        std::vector<Node*> __mNodes;        // Node objects (built only)
+        std::vector<Edge*> __mEdges;        // Edge objects (built only)
+
+    public:
+        GraphImage();
+        ~GraphImage();
+
+        void build(Graph& graph);
+        bool open(const char* file);
+        bool save(const char* file);
+        void close();
+
+        size_t node_count() const { return __mHeader->node_count; }
+        size_t edge_count() const { return __mHeader->edge_count; }
+        NodeID node_id(size_t i) const { return __mNodeIds[i]; }
+        size_t out_begin(size_t i) const { return __mOutOffsets[i]; }
+        size_t out_end(size_t i) const { return __mOutOffsets[i+1]; }
+        size_t in_begin(size_t i) const { return __mInOffsets[i]; }
+        size_t in_end(size_t i) const { return __mInOffsets[i+1]; }
+        size_t in_edge(size_t k) const { return __mInEdges[k]; }
+        size_t edge_src(size_t e) const { return __mEdgeSrc[e]; }
+        size_t edge_dest(size_t e) const { return __mEdgeDest[e]; }
+        EdgeWeight weight(size_t e) const { return __mWeights[e]; }
+        // Node and edge objects. NULL for a mapped image
+        Node* get_node(size_t i);
+        Edge* get_edge(size_t e);
+        // Node index of the id, node_count() if not exists
+        size_t find_node(NodeID node_id) const;
+
+        // Same as that of Graph
+        std::vector<Path> get_paths(NodeID src_id, NodeID dest_id,
+                size_t max_paths = 0);
+        NodeIDList get_involved_nodes(NodeID src_id, NodeID dest_id);
+        NodeIDList get_adjency_list(NodeID node_id, ADJNODETYPE type);
+        // Max flow b/w src and dest with the weights as capacities
+        // (Dinic). The edges of a min cut are added to cut
+        size_t max_flow(NodeID src_id, NodeID dest_id,
+                std::vector<size_t>* cut = NULL);
+        // No of simple paths b/w src and dest, in time linear in the
+        // size of the involved nodes. False if they have a cycle, then
+        // the nodes of each strongly connected component with a cycle
+        // are added to cycles
+        bool count_paths(NodeID src_id, NodeID dest_id, PathCount& count,
+                std::vector<NodeIDList>* cycles = NULL);
+
+    private:
+        GraphImage(const GraphImage&);
+        GraphImage& operator=(const GraphImage&);
+        static size_t __layout(size_t nodes, size_t edges, size_t* offsets);
+        void __attach(const char* base);
+        bool __is_valid() const;
+        void __mark_reachable(size_t start, ADJNODETYPE type,
+                std::vector<bool>& marked, size_t stop);
+        // Residual arc of max flow is edge * 2 (+ 1 for the reverse)
+        size_t __arc_head(size_t arc) const
+        { return (arc & 1) ? edge_src(arc >> 1) : edge_dest(arc >> 1); }
+        size_t __arc_tail(size_t arc) const
+        { return (arc & 1) ? edge_dest(arc >> 1) : edge_src(arc >> 1); }
+        bool __level_graph(size_t src, size_t dest,
+                const std::vector<size_t>& flow, std::vector<size_t>& level);
+        size_t __blocking_flow(size_t src, size_t dest,
+                std::vector<size_t>& flow, std::vector<size_t>& level,
+                std::vector<size_t>& next);
+};
+
+// Candidate for the next shortest path. It is the path found before
+// up to its spur node, then the detour, and then the rest of that path
+// from rejoin (if not NONE)
+struct PathCandidate
+{
+    size_t path;                    // Index of the path found before
+    size_t spur;                    // Edges taken from it before detour
+    std::vector<size_t> detour;     // Edges of detour
+    size_t rejoin;                  // Edges taken from it after detour
+};
+
+// Simple paths b/w src and dest of an image, found one at a time so
+// that the paths are not kept in memory. PATHS_DFS finds them depth
+// first in out edge order (as get_paths). PATHS_HOPS and PATHS_WEIGHT
+// find them shortest first by no of edges or by sum of weights (Yen's
+// k shortest loopless paths), keeping the paths found so far
+class PathIterator
+{
+    private:
+        GraphImage& __mImage;
+        PATHORDER __mOrder;
+        size_t __mSrc;                      // node_count() if not exists
+        size_t __mDest;
+        bool __mStarted;
+        bool __mTimedOut;
+        size_t __mTimeLimit;                // ms (0 for no limit)
+        std::chrono::steady_clock::time_point __mDeadline;
+        // Depth first
+        std::vector<bool> __mInvolved;      // Nodes that can reach dest
+        std::vector<bool> __mVisited;       // Nodes of the path
+        std::vector<size_t> __mNodes;       // Nodes of the path
+        std::vector<size_t> __mNext;        // Next out edge of each of them
+        // Shortest first. Paths are kept as their edges
+        std::vector<std::vector<size_t> > __mFound;
+        std::vector<size_t> __mFoundCost;
+        // Candidates by cost and order of adding
+        std::map<std::pair<size_t, size_t>, PathCandidate> __mCandidates;
+        size_t __mAdded;
+        std::vector<bool> __mBlockedNodes;
+        std::vector<bool> __mBlockedEdges;
+        std::vector<size_t> __mToDest;      // Distance to dest (unblocked)
+        std::vector<size_t> __mPos;         // Position in last path found
+        std::vector<size_t> __mRestCost;    // Cost of it from a position
+        std::vector<size_t> __mDist;        // Of shortest path search
+        std::vector<size_t> __mVia;
+        std::vector<size_t> __mTouched;
+
+    public:
+        PathIterator(GraphImage& image, NodeID src_id, NodeID dest_id,
+                PATHORDER order = PATHS_DFS);
+        // Stop the search after ms from now (0 for no limit)
+        void set_time_limit(size_t ms);
+        // Next path, false if no more or the time is over
+        bool next(Path& path);
+        bool timed_out() const { return __mTimedOut; }
+
+    private:
+        PathIterator(const PathIterator&);
+        PathIterator& operator=(const PathIterator&);
+        bool __is_time_over();
+        bool __next_dfs(Path& path);
+        bool __next_shortest(Path& path);
+        void __add_candidates();
+        size_t __cost(size_t edge) const;
+        void __set_dest_distances();
+        bool __shortest_path(size_t src, size_t spur,
+                std::vector<size_t>& edges, size_t& rejoin);
+        bool __is_rejoin(size_t node, size_t src);
+};
+
+// Node of a flow in the execution plan
+struct FlowNode
+{
+    size_t flow;        // Index of the flow
+    size_t node;        // Plan node index
+    size_t out_begin;   // Out edges of the flow from this node
+    size_t out_end;     // are [out_begin, out_end) in flow_edges
+    size_t in_begin;    // In edges of the flow to this node
+    size_t in_end;      // are [in_begin, in_end) in in_edges
+};
+
+// Read-only execution plan of the flows. Built once when the flows
+// are set up so that the cycle loop runs over flat arrays without
+// any lookup.
+// Nodes involved in any flow are numbered densely in ascending node
+// id order and the edges b/w them are numbered in out edge order of
+// their source node, so the out edges (and weights) of node i are
+// [out_offsets[i], out_offsets[i+1]).
+// The flows at node i are [node_flow_offsets[i], node_flow_offsets[i+1])
+// in flow_nodes, in order of flows. The edges of a flow (flow edges) are
+// stored in flow_edges grouped by their flow node at source
+struct FlowPlan
+{
+    NodeIDList node_ids;                 // Node id of each node
+    std::vector<size_t> nodes;           // Image node index of each node
+    std::vector<bool> member;            // Membership bitmap (by image index)
+    std::vector<size_t> out_offsets;     // Out edge range of each node
+    std::vector<EdgeWeight> weights;     // Weight of each edge
+    std::vector<size_t> edge_src;        // Source node index of each edge
+    std::vector<size_t> edge_dest;       // Destination node index of each edge
+    std::vector<size_t> edges;           // Image edge index of each edge
+
+    std::vector<size_t> node_flow_offsets;  // Flow node range of each node
+    std::vector<FlowNode> flow_nodes;       // Flow nodes
+    std::vector<size_t> flow_edges;         // Plan edge index of flow edges
+    std::vector<size_t> in_edges;           // Flow edge index of in edges
+
+    void clear();
+    size_t node_count() const { return node_ids.size(); }
+    size_t edge_count() const { return weights.size(); }
+};
+
+// A flow b/w src and dest
+struct Flow
+{
+    NodeID src_id;                  // Source of flow
+    NodeID dest_id;                 // Destination of flow
+    size_t src;                     // Flow node of source
+    size_t dest;                    // Flow node of destination
+    std::vector<size_t> nodes;      // Flow nodes (ascending node id)
+
+    Flow(NodeID src_node, NodeID dest_node)
+        :
+            src_id(src_node),
+            dest_id(dest_node),
+            src(0),
+            dest(0)
+    { }
+};
+
+// Timers (ns) and counters of the simulation (see STATS_TIMER)
+struct SimulationStats
+{
+    size_t flows;               // Flows simulated
+    size_t cycles;              // Cycles simulated
+    size_t cycles_skipped;      // Cycles fast-forwarded
+    uint64_t setup_time;        // Flow setup
+    uint64_t arbitration_time;  // Phase-1
+    uint64_t consumption_time;  // Phase-2
+    uint64_t format_time;       // Formatting the logs of the cycles
+    uint64_t log_io_time;       // Writing the log file
+    size_t nodes_arbitrated;
+    size_t nodes_consumed;
+    size_t edges_visited;       // Flow edges arbitrated
+    size_t distribute_loops;    // Loop iterations of __distribute_data
+
+    SimulationStats() { clear(); }
+    void clear();
+    void add(const SimulationStats& stats);
+    // Rows as name and value (times in ms)
+    void get_rows(std::vector<std::pair<std::string, std::string> >& rows) const;
+    void write_json(std::ostream& out, const char* indent) const;
+};
+
+# define STEADY_MAX_PERIOD 1024        // Max cycles of a steady state period
+# define STEADY_MAX_STATE (1 << 25)    // Max counters kept for a period
+
+// Options given with start_flow
+struct FlowOptions
+{
+    size_t max_paths;       // No of paths to be listed in log (0 for none)
+    PATHORDER path_order;   // Order of the paths listed
+    size_t path_time;       // ms to list the paths of a flow (0 for no limit)
+    size_t threads;         // No of worker threads (0 for all cores)
+    STATSFORMAT format;     // Format of flow statistics
+    size_t every;           // Print statistics every N cycles (0 for all)
+    size_t window;          // Print min/avg/max of W cycles (0 for none)
+    bool steady;            // Fast-forward the cycles once flows are steady
+    bool ratio;             // Print the flow rate to the max flow
+    std::string stats_file; // JSON file of the stats of the flow
+
+    FlowOptions()
+        :
+            max_paths(0),
+            path_order(PATHS_DFS),
+            path_time(0),
+            threads(1),
+            format(STATS_TEXT),
+            every(0),
+            window(0),
+            steady(true),
+            ratio(false)
+    { }
+};
+
+// Barrier for the worker threads of simulation. wait() returns
+// once all the threads have reached it
+class Barrier
+{
+    private:
+        std::mutex __mMutex;
+        std::condition_variable __mCond;
+        size_t __mCount;        // No of threads
+        size_t __mWaiting;      // No of threads reached
+        size_t __mGeneration;   // Incremented when all threads reached
+
+    public:
+        Barrier(size_t count)
+            :
+                __mCount(count),
+                __mWaiting(0),
+                __mGeneration(0)
+        { }
+        void wait();
+};
+
+// Worker of simulation. A worker arbitrates and consumes the data
+// of its own range of nodes in the plan. As arbitration writes only
+// the out edges of a node and consumption reads only its in edges,
+// the workers need to sync only b/w the phases.
+// Only the active nodes of the range are visited in a cycle: the nodes
+// with pkts to be sent or pkts txed in last cycle are arbitrated and
+// the nodes sent data to are consumed
+struct Worker
+{
+    size_t node_begin;                  // First node of worker
+    size_t node_end;                    // Past the last node of worker
+    std::vector<EdgeWeight> residual;   // For equal_split
+    std::vector<EdgeWeight> scratch;    // For equal_split
+    uint64_t hash;                      // Hash of pkts txed in cycle
+    SimulationStats stats;              // Counters of cycle
+    std::vector<size_t> active;         // Nodes to be arbitrated in cycle
+    std::vector<size_t> next;           // Nodes active in next cycle
+    // Nodes the worker sent data to in cycle, by worker owning them
+    std::vector<std::vector<size_t> > outbox;
+
+    Worker()
+        :
+            node_begin(0),
+            node_end(0),
+            hash(0)
+    { }
 };
 
 // Class for simulation.
-// taking the created graph as argument
-// can handle one flow (one src tp one dest) at a time
+// taking the created graph (or an opened graph image) as argument
+// The flows added are simulated together. They share the
+// capacity (weight) of the edges in every cycle
 class Simulation
 {
     private:
-        Graph*  __mGraph;   // Created graph
-        NodeID  __mSrc;     // source of flow
-        NodeID  __mDest;    // destination of flow
-        std::set<NodeID> __mNodeSet;  // Filter of node ids thats involves
+        Graph*  __mGraph;   // Created graph (NULL for opened image)
+        GraphImage* __mImage;       // Image the flows are set up from
+        NodeID  __mSrc;     // source of last flow
+        NodeID  __mDest;    // destination of last flow
+        std::vector<Flow> __mFlows;     // Flows to be simulated
+        std::string __mLogFile;         // Log file of simulation
+        FlowPlan __mPlan;               // Execution plan of the flows
+
+        // Counters indexed by flow edge
+        std::vector<size_t> __mPktsTransferred;       // In current cycle
+        std::vector<size_t> __mTotalPktsTransferred;  // So far
+        // Counters indexed by flow node
+        std::vector<size_t> __mPktsToBeSent;
+        std::vector<size_t> __mTotalPktsRecv;
+        std::vector<size_t> __mTotalPktsSent;
+        // Capacity used in current cycle by all flows (by plan edge)
+        std::vector<EdgeWeight> __mEdgeUsed;
+        std::vector<Worker> __mWorkers;               // Workers of cycle loop
+        size_t __mMaxOutEdges;                        // Max out edges of node
+        FlowOptions __mOptions;                       // Options of the flows
+        size_t __mCycles;                             // No of cycles to run
+        // Counters of last cycle written (binary statistics)
+        std::vector<size_t> __mLastEdgeTotals;        // By flow edge
+        std::vector<size_t> __mLastNodeCounters;      // 3 by flow node
+        // Min/max/sum of the window (pkts txed by flow edge and pkts
+        // remaining by flow node)
+        std::vector<size_t> __mWindowEdges;           // 3 by flow edge
+        std::vector<size_t> __mWindowNodes;           // 3 by flow node
+        size_t __mWindowCycles;                       // Cycles in window
+        // Active frontier (by plan node)
+        std::vector<size_t> __mNodeWorker;            // Worker of node
+        std::vector<size_t> __mConsumedAt;            // Last cycle + 1
+        std::vector<size_t> __mActiveAt;              // consumed/active in
+        // Steady state of the flows (see __detect_steady_state)
+        size_t __mPhase;            // Cycles arbitration order repeats in
+        std::vector<uint64_t> __mCycleHashes;         // By cycle (ring)
+        std::vector<size_t> __mRepeats;               // By period
+        size_t __mPeriod;                             // Period verified
+        size_t __mPeriodStart;                        // Cycles run before it
+        // Counters at start of the period and after each cycle of it
+        std::vector<size_t> __mPeriodStates;
+        size_t __mSteadyCycles;     // Cycles run when found (0 if not)
+        // Instrumentation of last cycle, last start and all starts
+        SimulationStats __mCycleStats;
+        SimulationStats __mFlowStats;
+        SimulationStats __mTotalStats;
 
     public:
         Simulation(Graph* graph)
             :
-                __mGraph(graph)
+                __mGraph(graph),
+                __mImage(NULL),
+                __mMaxOutEdges(0),
+                __mCycles(0),
+                __mWindowCycles(0),
+                __mPhase(0),
+                __mPeriod(0),
+                __mPeriodStart(0),
+                __mSteadyCycles(0)
+        { }
+        // Simulate on the image. Counters are not written back to it
+        Simulation(GraphImage* image)
+            :
+                __mGraph(NULL),
+                __mImage(image),
+                __mMaxOutEdges(0),
+                __mCycles(0),
+                __mWindowCycles(0),
+                __mPhase(0),
+                __mPeriod(0),
+                __mPeriodStart(0),
+                __mSteadyCycles(0)
         { }
         ~Simulation(){}
 
-        bool update_src_and_dest(NodeID src, NodeID dest);
+        // Set up single flow b/w src and dest
+        bool update_src_and_dest(NodeID src, NodeID dest,
+                size_t max_paths = 0);
         NodeID get_src();
         NodeID get_dest();
-        // start simulation
-        void start(NodeID src, NodeID dest, size_t no_of_cylce);
+        // Add a flow to be simulated with other flows
+        void add_flow(NodeID src, NodeID dest);
+        size_t get_flow_count();
+        // Set up all added flows
+        bool setup_flows(size_t max_paths = 0);
+        // start simulation of single flow
+        void start(NodeID src, NodeID dest, size_t no_of_cylce,
+                const FlowOptions& options = FlowOptions());
+        // start simulation of all added flows
+        void start(size_t no_of_cylce,
+                const FlowOptions& options = FlowOptions());
         // Reset all attributes count to zero
         void reset_counters();
-        void print_node_statistics();
+        void print_edge_statistics(Flow& flow);
+        void print_node_statistics(Flow& flow);
+        // Print the instrumentation (make STATS=yes)
+        void print_stats(std::ostream& out);
+        bool write_stats(const std::string& file);
+        // Divide pkts equally across edges of given capacity
+        static size_t equal_split(const EdgeWeight* capacity, size_t count,
+                size_t no_pkt_tbs, size_t* pkts, EdgeWeight* scratch);
 
     private:
-        void __update_node_set(NodeID src, NodeID dest);
-        void __start_arbitration();
-        void __start_consumption();
+        bool __open_log();
+        void __print_flow_heading(Flow& flow);
+        void __update_node_set(Flow& flow, NodeIDList& node_set,
+                size_t max_paths);
+        void __build_plan(std::vector<NodeIDList>& node_sets);
+        void __build_flow_edges(Flow& flow, std::vector<size_t>& at,
+                std::vector<size_t>& edge_index, bool fill);
+        void __write_back_counters();
+        void __print_flow_statistics(Flow& flow);
+        void __setup_workers(size_t threads);
+        void __run_worker(size_t worker, size_t no_of_cylce, Barrier& barrier);
+        void __print_cycle(size_t cycle);
+        void __write_stats_header();
+        void __write_cycle_stats(size_t cycle);
+        void __update_window();
+        void __print_window(size_t cycle);
+        void __write_flow_stats();
+        void __detect_steady_state(size_t cycle);
+        bool __is_steady();
+        size_t __state_size();
+        void __save_state(size_t slot);
+        void __load_state(size_t cycles);
+        void __fast_forward();
+        void __collect_cycle_stats();
+        void __start_arbitration(size_t cycle, Worker& worker);
+        void __start_consumption(size_t cycle, size_t worker);
+        bool __is_active(size_t node);
+        void __arbitrate_node(size_t node, size_t cycle, Worker& worker);
+        void __consume_node(size_t node);
         // data distribution (phase-1)
-        void __distribute_data(Node* node, size_t no_pkt_tbs);
-        // printing statistics (phase-2)
-        void __consume_data(Node*);
+        void __distribute_data(size_t flow_node, size_t no_pkt_tbs,
+                Worker& worker);
+        // data consumption (phase-2)
+        void __consume_data(size_t flow_node);
 };
 
 #endif
@@ -3,57 +3,248 @@
 
 // Global pointer for graph and simulation
 static Graph* gGraph = NULL;
+static GraphImage* gImage = NULL;   // Opened graph image (read-only)
 static Simulation* gSimulation = NULL;
 
-void parse_cmd_and_execute(Cli* cli, std::string& buf)
+// Get the statistics format and how often it is logged
+bool parse_stats_format(Cli* cli, FlowOptions& options)
 {
-    // Returns, if parsing failed due to invalid options
-    if(!cli->parse_cmds(buf)){
+    const char* format = cli->get_value("-format");
+    if (format == NULL || std::string(format) == "text") {
+        options.format = STATS_TEXT;
+    }
+    else if (std::string(format) == "bin") {
+        options.format = STATS_BINARY;
+    }
+    else {
+        std::cout << "\nError : Invalid format " << format << "\n";
+        return false;
+    }
+
+    if (cli->get_value("-ratio")) {
+        options.ratio = true;
+        if (options.format == STATS_BINARY) {
+            std::cout << "\nError : -ratio can be given only with text format\n";
+            return false;
+        }
+    }
+    if (cli->get_value("-every")) {
+        options.every = cli->get_number("-every");
+    }
+    if (cli->get_value("-stats_file")) {
+        options.stats_file = cli->get_value("-stats_file");
+    }
+    if (cli->get_value("-window")) {
+        options.window = cli->get_number("-window");
+        if (options.every) {
+            std::cout << "\nError : -window and -every can't be given together\n";
+            return false;
+        }
+        if (options.format == STATS_BINARY) {
+            std::cout << "\nError : -window can be given only with text format\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse the options of listing the paths of start_flow/start_flows
+bool parse_path_options(Cli* cli, FlowOptions& options)
+{
+    if (cli->get_value("-max_paths")) {
+        options.max_paths = cli->get_number("-max_paths");
+    }
+    const char* order = cli->get_value("-path_order");
+    if (order == NULL || std::string(order) == "dfs") {
+        options.path_order = PATHS_DFS;
+    }
+    else if (std::string(order) == "hops") {
+        options.path_order = PATHS_HOPS;
+    }
+    else if (std::string(order) == "weight") {
+        options.path_order = PATHS_WEIGHT;
+    }
+    else {
+        std::cout << "\nError : Invalid path order " << order << "\n";
+        return false;
+    }
+    if (cli->get_value("-path_time")) {
+        options.path_time = cli->get_number("-path_time");
+    }
+    return true;
+}
+
+// Print the max flow b/w src and dest and the edges of a min cut
+void print_max_flow(GraphImage& image, NodeID src, NodeID dest)
+{
+    if ((image.find_node(src) == image.node_count()) ||
+            (image.find_node(dest) == image.node_count())) {
+        std::cout << "\nError: Node not exists in graph\n";
         return;
     }
+    if (src == dest) {
+        std::cout << "\nError: Source and destination are same\n";
+        return;
+    }
+    std::vector<size_t> cut;
+    size_t flow = image.max_flow(src, dest, &cut);
+    std::cout << "\nMax flow from " << src << " to " << dest << "\t:\t"
+        << flow << "\n";
+    std::cout << "Min cut edges\t\t:\t" << cut.size() << "\n";
+    for (size_t k = 0; k < cut.size(); ++k) {
+        size_t e = cut[k];
+        std::cout << "    " << image.node_id(image.edge_src(e)) << " ----> "
+            << image.node_id(image.edge_dest(e)) << "\t(weight "
+            << image.weight(e) << ")\n";
+    }
+}
+
+// Print the no of simple paths b/w src and dest, or the cycles of the
+// involved nodes that make counting them impossible
+void print_path_count(GraphImage& image, NodeID src, NodeID dest)
+{
+    if ((image.find_node(src) == image.node_count()) ||
+            (image.find_node(dest) == image.node_count())) {
+        std::cout << "\nError: Node not exists in graph\n";
+        return;
+    }
+    PathCount count;
+    std::vector<NodeIDList> cycles;
+    if (image.count_paths(src, dest, count, &cycles)) {
+        std::cout << "\nPaths from " << src << " to " << dest << "\t:\t"
+            << count.to_string() << "\n";
+        return;
+    }
+    std::cout << "\nError: Paths can't be counted, involved nodes have "
+        << cycles.size() << " cycle(s)\n";
+    for (size_t c = 0; c < cycles.size(); ++c) {
+        const NodeIDList& nodes = cycles[c];
+        std::cout << "    " << nodes.size() << " nodes :";
+        for (size_t k = 0; (k < nodes.size()) && (k < 10); ++k) {
+            std::cout << " " << nodes[k];
+        }
+        std::cout << ((nodes.size() > 10) ? " ...\n" : "\n");
+    }
+}
 
+// Execute the command parsed
+void execute_cmd(Cli* cli)
+{
     // Command to create graph
     if(cli->get_value("create_graph"))    {
-        int max_node = atoi(cli->get_value("-max_node"));
-        int max_edge = atoi(cli->get_value("-max_edge"));
+        int max_node = cli->get_number("-max_node");
+        int max_edge = cli->get_number("-max_edge");
 
-        if (gGraph){
+        if (gGraph || gImage){
             std::cout << "Already graph created\n";
             return;
         }
         gGraph = new Graph(max_node, max_edge);
         return;
     }
+    // Open the image written by save_graph, in place of a graph
+    if(cli->get_value("open_graph"))    {
+        if (gGraph || gImage){
+            std::cout << "Already graph created\n";
+            return;
+        }
+        gImage = new GraphImage();
+        if (!gImage->open(cli->get_value("-file"))) {
+            delete gImage;
+            gImage = NULL;
+        }
+        return;
+    }
+    // Flows can be simulated on the opened image, but it can't be changed
+    if(gImage){
+        if (cli->get_value("save_graph")){
+            gImage->save(cli->get_value("-file"));
+            return;
+        }
+        if (cli->get_value("delete_graph")){
+            delete gSimulation;
+            gSimulation = NULL;
+            delete gImage;
+            gImage = NULL;
+            return;
+        }
+        if (!cli->get_value("start_flow") && !cli->get_value("add_flow") &&
+                !cli->get_value("start_flows") && !cli->get_value("max_flow") &&
+                !cli->get_value("count_paths") && !cli->get_value("stats")) {
+            std::cout << "\nError : The opened graph is read-only\n";
+            return;
+        }
+        if(gSimulation == NULL)    {
+            gSimulation = new Simulation(gImage);
+        }
+    }
     // All other command is available if the graph is created
-    if(gGraph){
+    if(gGraph || gImage){
         if (cli->get_value("add_node")){
-            NodeID id = atoi(cli->get_value("add_node"));
+            NodeID id = cli->get_number("add_node");
             gGraph->add_node(id);
             return;
         }
 
         if (cli->get_value("delete_node")){
-            NodeID id = atoi(cli->get_value("delete_node"));
+            NodeID id = cli->get_number("delete_node");
             gGraph->delete_node(id);
             return;
         }
 
         if (cli->get_value("add_edge")){
-            NodeID src = atoi(cli->get_value("-src_node"));
-            NodeID dest = atoi(cli->get_value("-dest_node"));
-            EdgeWeight weight = atoi(cli->get_value("-weight"));
+            NodeID src = cli->get_number("-src_node");
+            NodeID dest = cli->get_number("-dest_node");
+            EdgeWeight weight = cli->get_number("-weight");
             gGraph->add_edge(src, dest, weight);
             return;
         }
 
+        if (cli->get_value("load_graph")){
+            gGraph->load_edges(cli->get_value("-file"));
+            return;
+        }
+
+        if (cli->get_value("save_graph")){
+            gGraph->freeze().save(cli->get_value("-file"));
+            return;
+        }
+
+        if (cli->get_value("max_flow")){
+            NodeID src = cli->get_number("-src_node");
+            NodeID dest = cli->get_number("-dest_node");
+            print_max_flow(gImage ? *gImage : gGraph->freeze(), src, dest);
+            return;
+        }
+
+        if (cli->get_value("count_paths")){
+            NodeID src = cli->get_number("-src_node");
+            NodeID dest = cli->get_number("-dest_node");
+            print_path_count(gImage ? *gImage : gGraph->freeze(), src, dest);
+            return;
+        }
+
+        // Instrumentation of the last cycle, last start and all starts
+        if (cli->get_value("stats")){
+            if (gSimulation == NULL) {
+                std::cout << "\nError : No flow is started. Start flow first\n";
+                return;
+            }
+            gSimulation->print_stats(std::cout);
+            return;
+        }
+
         if (cli->get_value("delete_edge")){
-            NodeID src = atoi(cli->get_value("-src_node"));
-            NodeID dest = atoi(cli->get_value("-dest_node"));
+            NodeID src = cli->get_number("-src_node");
+            NodeID dest = cli->get_number("-dest_node");
             gGraph->delete_edge(src, dest);
             return;
         }
 
         if (cli->get_value("delete_graph")){
+            // Simulation refers the graph, so delete it as well
+            delete gSimulation;
+            gSimulation = NULL;
             delete gGraph;
             gGraph = NULL;
             return;
@@ -62,15 +253,53 @@ void parse_cmd_and_execute(Cli* cli, std::string& buf)
         // NOTE: The option time is now used as number of cycles
         // in the data flow
         if (cli->get_value("start_flow")){
-            NodeID src = atoi(cli->get_value("-src_node"));
-            NodeID dest = atoi(cli->get_value("-dest_node"));
-            size_t time = atoi(cli->get_value("-time"));
+            NodeID src = cli->get_number("-src_node");
+            NodeID dest = cli->get_number("-dest_node");
+            size_t time = cli->get_number("-time");
+            FlowOptions options;
+            if (cli->get_value("-threads")) {
+                options.threads = cli->get_number("-threads");
+            }
+            if (!parse_path_options(cli, options) ||
+                    !parse_stats_format(cli, options)) {
+                return;
+            }
             // Create simulation object if it is not there.
             if(gSimulation == NULL)    {
                 gSimulation = new Simulation(gGraph);
             }
-            gSimulation->start(src, dest, time);
-            return;        }
+            gSimulation->start(src, dest, time, options);
+            return;
+        }
+
+        if (cli->get_value("add_flow")){
+            NodeID src = cli->get_number("-src_node");
+            NodeID dest = cli->get_number("-dest_node");
+            if(gSimulation == NULL)    {
+                gSimulation = new Simulation(gGraph);
+            }
+            gSimulation->add_flow(src, dest);
+            return;
+        }
+
+        // Start all flows added, they share the edges
+        if (cli->get_value("start_flows")){
+            size_t time = cli->get_number("-time");
+            FlowOptions options;
+            if (cli->get_value("-threads")) {
+                options.threads = cli->get_number("-threads");
+            }
+            if (!parse_path_options(cli, options) ||
+                    !parse_stats_format(cli, options)) {
+                return;
+            }
+            if((gSimulation == NULL) || (!gSimulation->get_flow_count())) {
+                std::cout << "\nError : No flow is added. Add flow first\n";
+                return;
+            }
+            gSimulation->start(time, options);
+            return;
+        }
     }
     else{
         std::cout << "\nError : The graph is not created. Create graph first\n";
@@ -78,24 +307,71 @@ void parse_cmd_and_execute(Cli* cli, std::string& buf)
     }
 }
 
+void parse_cmd_and_execute(Cli* cli, std::string& buf)
+{
+    // Returns, if parsing failed due to invalid options
+    if(!cli->parse_cmds(buf)){
+        return;
+    }
+    execute_cmd(cli);
+}
+
+// Parse the lines of batch file into the queue
+void parse_lines(Cli* cli, const char* begin, const char* end,
+        CmdQueue* queue)
+{
+    const char* spaces = " \n\r\t";
+    while (begin != end) {
+        const char* eol = (const char*)memchr(begin, '\n', end - begin);
+        if (eol == NULL) {
+            eol = end;
+        }
+        // Trimming white spaces
+        std::string_view line(begin, eol - begin);
+        size_t first = line.find_first_not_of(spaces);
+        if (first != std::string_view::npos) {
+            line = line.substr(first, line.find_last_not_of(spaces) + 1 - first);
+            cli->parse(line, queue->back());
+            queue->push();
+        }
+        begin = (eol == end) ? end : eol + 1;
+    }
+    queue->close();
+}
+
+// The commands are parsed in a thread of its own, ahead of their
+// execution in this thread
 void start_batch_mode(Cli* cli, const char* file)
 {
-    // Open file and read commands line by line
-    std::ifstream infile(file);
-    if(infile.fail()) {
+    // Map the file to read the commands line by line
+    int fd = open(file, O_RDONLY);
+    if(fd < 0) {
         std::cout << "\nError: Failed to open file " << file << "\n";
         return;
     }
-    std::string str;
-    while (std::getline(infile, str)) {
-        // Trimming white spaces
-        str.erase(0, str.find_first_not_of(" \n\r\t"));
-        str.erase(str.find_last_not_of(" \n\r\t")+1);
-        if(str.size()) {
-            cli->reset_values();
-            parse_cmd_and_execute(cli, str);
+    struct stat st;
+    void* map = MAP_FAILED;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    CmdQueue queue(4096);
+    const char* begin = (const char*)map;
+    std::thread parser(parse_lines, cli, begin, begin + st.st_size, &queue);
+    ParsedCmd* cmd;
+    while ((cmd = queue.front())) {
+        if (cli->use_cmd(*cmd)) {
+            execute_cmd(cli);
         }
+        queue.pop();
     }
+    parser.join();
+    munmap(map, st.st_size);
 }
 
 // Start interactive mode
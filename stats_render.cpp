@@ -0,0 +1,299 @@
+# include "cli.hpp"
+# include "graph.hpp"
+
+// Output format of the statistics
+typedef enum {RENDER_TEXT, RENDER_CSV} RENDERFORMAT;
+
+// Rows of the statistics tables of a flow
+struct FlowRows
+{
+    NodeID src;
+    NodeID dest;
+    // Edge rows
+    std::vector<NodeID> edge_src;
+    std::vector<NodeID> edge_dest;
+    std::vector<EdgeWeight> weights;
+    std::vector<size_t> pkts_txed;
+    std::vector<size_t> total_pkts_txed;
+    // Node rows
+    std::vector<NodeID> nodes;
+    std::vector<size_t> total_pkts_recv;
+    std::vector<size_t> total_pkts_sent;
+    std::vector<size_t> pkts_remaining;
+};
+
+// Read an unsigned LEB128 number. Returns false at end of file
+bool read_varint(std::istream& in, size_t& n)
+{
+    n = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+        int c = in.get();
+        if (c == EOF) {
+            return false;
+        }
+        n |= (size_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool read_header(std::istream& in, std::vector<FlowRows>& flows)
+{
+    size_t count;
+    if (!read_varint(in, count)) {
+        return false;
+    }
+    flows.resize(count);
+    for (size_t f = 0; f < count; ++f) {
+        FlowRows& flow = flows[f];
+        size_t value, rows;
+        if (!read_varint(in, value)) return false;
+        flow.src = value;
+        if (!read_varint(in, value)) return false;
+        flow.dest = value;
+
+        if (!read_varint(in, rows)) return false;
+        for (size_t r = 0; r < rows; ++r) {
+            if (!read_varint(in, value)) return false;
+            flow.edge_src.push_back(value);
+            if (!read_varint(in, value)) return false;
+            flow.edge_dest.push_back(value);
+            if (!read_varint(in, value)) return false;
+            flow.weights.push_back(value);
+        }
+        flow.pkts_txed.assign(rows, 0);
+        flow.total_pkts_txed.assign(rows, 0);
+
+        if (!read_varint(in, rows)) return false;
+        for (size_t r = 0; r < rows; ++r) {
+            if (!read_varint(in, value)) return false;
+            flow.nodes.push_back(value);
+        }
+        flow.total_pkts_recv.assign(rows, 0);
+        flow.total_pkts_sent.assign(rows, 0);
+        flow.pkts_remaining.assign(rows, 0);
+    }
+    return true;
+}
+
+// Read the counters of a cycle and update the rows. The counters are
+// the changes from the last cycle written
+bool read_cycle(std::istream& in, std::vector<FlowRows>& flows)
+{
+    for (size_t f = 0; f < flows.size(); ++f) {
+        FlowRows& flow = flows[f];
+        size_t value;
+        for (size_t r = 0; r < flow.edge_src.size(); ++r) {
+            if (!read_varint(in, value)) return false;
+            flow.pkts_txed[r] = value;
+            if (!read_varint(in, value)) return false;
+            flow.total_pkts_txed[r] += value;
+        }
+        for (size_t r = 0; r < flow.nodes.size(); ++r) {
+            if (!read_varint(in, value)) return false;
+            flow.total_pkts_recv[r] += value;
+            if (!read_varint(in, value)) return false;
+            flow.total_pkts_sent[r] += value;
+            // Zigzag encoded change
+            if (!read_varint(in, value)) return false;
+            flow.pkts_remaining[r] += (value >> 1) ^ (0 - (value & 1));
+        }
+    }
+    return true;
+}
+
+void print_cycle(std::vector<FlowRows>& flows, size_t cycle)
+{
+    Log::print_cycle_heading(cycle);
+    for (size_t f = 0; f < flows.size(); ++f) {
+        FlowRows& flow = flows[f];
+        if (flows.size() > 1) {
+            Log::print_flow_heading(flow.src, flow.dest);
+        }
+        Log::print_edge_statistics_heading();
+        for (size_t r = 0; r < flow.edge_src.size(); ++r) {
+            Log::print_edge_statistics(flow.edge_src[r], flow.edge_dest[r],
+                    flow.weights[r], flow.pkts_txed[r],
+                    flow.total_pkts_txed[r]);
+        }
+        Log::print_node_statistics_heading();
+        for (size_t r = 0; r < flow.nodes.size(); ++r) {
+            Log::print_node_statistics(flow.nodes[r], flow.total_pkts_recv[r],
+                    flow.total_pkts_sent[r], flow.pkts_remaining[r]);
+        }
+    }
+}
+
+void print_csv_cycle(std::vector<FlowRows>& flows, size_t cycle)
+{
+    for (size_t f = 0; f < flows.size(); ++f) {
+        FlowRows& flow = flows[f];
+        std::string prefix(Log::itos(cycle));
+        prefix.append(",").append(Log::itos(flow.src));
+        prefix.append(",").append(Log::itos(flow.dest));
+        for (size_t r = 0; r < flow.edge_src.size(); ++r) {
+            std::string row(prefix);
+            row.append(",edge,").append(Log::itos(flow.edge_src[r]));
+            row.append(",").append(Log::itos(flow.edge_dest[r]));
+            row.append(",").append(Log::itos(flow.weights[r]));
+            row.append(",").append(Log::itos(flow.pkts_txed[r]));
+            row.append(",").append(Log::itos(flow.total_pkts_txed[r]));
+            row.append(",,,\n");
+            Log::print(row);
+        }
+        for (size_t r = 0; r < flow.nodes.size(); ++r) {
+            std::string row(prefix);
+            row.append(",node,").append(Log::itos(flow.nodes[r]));
+            row.append(",,,,");
+            row.append(",").append(Log::itos(flow.total_pkts_recv[r]));
+            row.append(",").append(Log::itos(flow.total_pkts_sent[r]));
+            if (flow.pkts_remaining[r] == INFINITY) {
+                row.append(",Infinity\n");
+            }
+            else {
+                row.append(",").append(Log::itos(flow.pkts_remaining[r]));
+                row.append("\n");
+            }
+            Log::print(row);
+        }
+    }
+}
+
+// Render the cycles [first, last] of the statistics file
+bool render(std::istream& in, RENDERFORMAT format, size_t first, size_t last)
+{
+    char magic[STATS_MAGIC_SIZE];
+    if (!in.read(magic, STATS_MAGIC_SIZE) ||
+            std::string(magic, STATS_MAGIC_SIZE) != STATS_MAGIC) {
+        std::cout << "\nError: Not a flow statistics file\n";
+        return false;
+    }
+
+    // Text printed before the cycles
+    std::string text;
+    if (!std::getline(in, text, '\0')) {
+        std::cout << "\nError: Unexpected end of file\n";
+        return false;
+    }
+    std::vector<FlowRows> flows;
+    if (!read_header(in, flows)) {
+        std::cout << "\nError: Unexpected end of file\n";
+        return false;
+    }
+
+    if (format == RENDER_TEXT) {
+        Log::print(text);
+    }
+    else {
+        Log::print("cycle,flow_src,flow_dest,type,src,dest,weight,"
+                "pkts_txed,total_pkts_txed,total_pkts_recv,"
+                "total_pkts_sent,pkts_remaining\n");
+    }
+
+    size_t cycle;
+    while (true) {
+        int tag = in.get();
+        if (tag == 'C') {
+            if (!read_varint(in, cycle) || !read_cycle(in, flows)) {
+                break;
+            }
+            if (cycle < first || cycle > last) {
+                continue;
+            }
+            if (format == RENDER_TEXT) {
+                print_cycle(flows, cycle);
+            }
+            else {
+                print_csv_cycle(flows, cycle);
+            }
+        }
+        else if (tag == 'E') {
+            if (format == RENDER_CSV) {
+                return true;
+            }
+            Log::print_flow_statistics_heading();
+            for (size_t f = 0; f < flows.size(); ++f) {
+                size_t sent, recv;
+                if (!read_varint(in, sent) || !read_varint(in, recv)) {
+                    break;
+                }
+                Log::print_flow_statistics(flows[f].src, flows[f].dest,
+                        sent, recv, flows.size() > 1);
+            }
+            return true;
+        }
+        else {
+            break;
+        }
+    }
+    std::cout << "\nError: Unexpected end of file\n";
+    return false;
+}
+
+void print_usage(char* name)
+{
+    std::cout << "\n\n  Usage : " << name << " -file <FILE_NAME> [OPTIONS]\n\n";
+    std::cout << "  -file <FILE_NAME>                Statistics file written by start_flow -format bin\n\n";
+    std::cout << "  -out <FILE_NAME>                 Output file (default: FILE_NAME with .log/.csv)\n\n";
+    std::cout << "  -format <text|csv>               Statistics tables as in log (default) or csv\n\n";
+    std::cout << "  -from <CYCLE>                    First cycle to be rendered (default: 1)\n\n";
+    std::cout << "  -to <CYCLE>                      Last cycle to be rendered (default: last)\n\n";
+    exit(-1);
+}
+
+int main(int argc, char** argv)
+{
+    Cli *cli = Cli::Instance();
+    char** end = argv + argc;
+
+    const char* file = cli->get_cmd_value(argv, end, "-file");
+    if (!file) {
+        print_usage(argv[0]);
+    }
+
+    RENDERFORMAT format = RENDER_TEXT;
+    const char* value = cli->get_cmd_value(argv, end, "-format");
+    if (value && std::string(value) == "csv") {
+        format = RENDER_CSV;
+    }
+    else if (value && std::string(value) != "text") {
+        print_usage(argv[0]);
+    }
+
+    size_t first = 1;
+    size_t last = (size_t)-1;
+    if ((value = cli->get_cmd_value(argv, end, "-from"))) {
+        first = atoi(value);
+    }
+    if ((value = cli->get_cmd_value(argv, end, "-to"))) {
+        last = atoi(value);
+    }
+
+    std::string out;
+    if ((value = cli->get_cmd_value(argv, end, "-out"))) {
+        out = value;
+    }
+    else {
+        out = file;
+        size_t dot = out.rfind('.');
+        if (dot != std::string::npos && out.find('/', dot) == std::string::npos) {
+            out.erase(dot);
+        }
+        out.append((format == RENDER_TEXT) ? ".log" : ".csv");
+    }
+
+    std::ifstream in(file, std::ifstream::binary);
+    if (in.fail()) {
+        std::cout << "\nError: Failed to open file " << file << "\n";
+        return -1;
+    }
+    if (!Log::open(out)) {
+        std::cout << "\nError: Failed to create file " << out << "\n";
+        return -1;
+    }
+    bool done = render(in, format, first, last);
+    Log::close();
+    return done ? 0 : -1;
+}